@@ -0,0 +1,277 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+
+#include "hanoi.h"
+
+// Configurations of n disks on k pegs, encoded base k: digit d holds the
+// peg of disk d + 1, so disk 1 is the least significant digit
+class HanoiStateSpace {
+public:
+  static constexpr uint64_t maxStates = uint64_t(1) << 40;
+
+  HanoiStateSpace(int numPegs, int n) : k(numPegs), _n(n) {
+    power.push_back(1);
+    for (int d = 0; d < n; d++) {
+      if (power.back() > maxStates / k) {
+        throw std::invalid_argument("State space too large");
+      }
+      power.push_back(power.back() * k);
+    }
+  }
+
+  uint64_t numStates() const { return power[_n]; }
+
+  uint64_t allOn(int peg) const { return (numStates() - 1) / (k - 1) * peg; }
+
+  // Calls f(next) for every state one legal move away, moving disks only
+  // along the edges of adjacency
+  template <typename F>
+  void forEachNeighbor(uint64_t state, const std::vector<PegMask>& adjacency,
+                       F f) const {
+    // Smallest disk on each peg is its top
+    int top[PegAdjacencyList::maxPegs];
+    std::fill(top, top + k, -1);
+    PegMask occupied = 0;
+    uint64_t rest = state;
+    for (int d = 0; d < _n; d++) {
+      int peg = rest % k;
+      rest /= k;
+      if (!(occupied & pegBit(peg))) {
+        top[peg] = d;
+        occupied |= pegBit(peg);
+      }
+    }
+
+    for (int src = 0; src < k; src++) {
+      if (top[src] < 0) continue;
+      int disk = top[src];
+      for (PegMask dsts = adjacency[src]; dsts; dsts &= dsts - 1) {
+        int dst = std::countr_zero(dsts);
+        if (top[dst] >= 0 && top[dst] < disk) continue;
+        f(state + (uint64_t(dst) - uint64_t(src)) * power[disk]);
+      }
+    }
+  }
+
+private:
+  int k;
+  int _n;
+  std::vector<uint64_t> power;
+};
+
+class AtomicBitset {
+public:
+  AtomicBitset(uint64_t bits) : words((bits + 63) / 64) {}
+
+  // Returns true if the bit was not already set
+  bool set(uint64_t i) {
+    uint64_t mask = uint64_t(1) << (i & 63);
+    return !(words[i >> 6].fetch_or(mask, std::memory_order_relaxed) & mask);
+  }
+
+  bool test(uint64_t i) const {
+    return words[i >> 6].load(std::memory_order_relaxed) >> (i & 63) & 1;
+  }
+
+private:
+  std::vector<std::atomic<uint64_t>> words;
+};
+
+// Expands one BFS level across threads. Returns the next frontier, and sets
+// met if any new state was already visited by the other search.
+std::vector<uint64_t> expandFrontier(const HanoiStateSpace& space,
+                                     const std::vector<uint64_t>& frontier,
+                                     const std::vector<PegMask>& adjacency,
+                                     AtomicBitset& visited,
+                                     const AtomicBitset& otherVisited,
+                                     int numThreads, bool& met) {
+  std::vector<std::vector<uint64_t>> partial(numThreads);
+  std::atomic<bool> anyMet(false);
+  std::vector<std::thread> workers;
+  size_t chunk = (frontier.size() + numThreads - 1) / numThreads;
+
+  for (int t = 0; t < numThreads; t++) {
+    workers.emplace_back([&, t]() {
+      size_t begin = std::min(frontier.size(), t * chunk);
+      size_t end = std::min(frontier.size(), begin + chunk);
+      for (size_t i = begin; i < end; i++) {
+        space.forEachNeighbor(frontier[i], adjacency, [&](uint64_t next) {
+          if (!visited.set(next)) return;
+          if (otherVisited.test(next)) {
+            anyMet.store(true, std::memory_order_relaxed);
+          }
+          partial[t].push_back(next);
+        });
+      }
+    });
+  }
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  std::vector<uint64_t> next;
+  size_t total = 0;
+  for (const auto& p : partial) total += p.size();
+  next.reserve(total);
+  for (const auto& p : partial) next.insert(next.end(), p.begin(), p.end());
+
+  met = anyMet.load();
+  return next;
+}
+
+// Optimal move count from all disks on src to all disks on dst, or -1 if
+// unreachable. Each side keeps one bit per state; the side with the smaller
+// frontier is expanded a full level at a time. Before each expansion the
+// visited sets are disjoint, so the distance exceeds the sum of both depths,
+// and the first level that meets the other side fixes it exactly.
+long long bidirectionalBfs(const PegAdjacencyList& graph, int n,
+                           int src, int dst, int numThreads) {
+  HanoiStateSpace space(graph.names.size(), n);
+  uint64_t start = space.allOn(src);
+  uint64_t goal = space.allOn(dst);
+  if (start == goal) return 0;
+
+  // The backward search undoes moves, so it follows edges in reverse
+  std::vector<PegMask> reverse(graph.adjacency.size(), 0);
+  for (size_t p = 0; p < graph.adjacency.size(); p++) {
+    for (size_t q = 0; q < graph.adjacency.size(); q++) {
+      if (graph.adjacency[p] & pegBit(q)) reverse[q] |= pegBit(p);
+    }
+  }
+
+  AtomicBitset forwardVisited(space.numStates());
+  AtomicBitset backwardVisited(space.numStates());
+  forwardVisited.set(start);
+  backwardVisited.set(goal);
+
+  std::vector<uint64_t> forward = {start};
+  std::vector<uint64_t> backward = {goal};
+  long long forwardDepth = 0, backwardDepth = 0;
+  bool met = false;
+
+  while (!forward.empty() && !backward.empty()) {
+    if (forward.size() <= backward.size()) {
+      forward = expandFrontier(space, forward, graph.adjacency, forwardVisited,
+                               backwardVisited, numThreads, met);
+      forwardDepth++;
+    } else {
+      backward = expandFrontier(space, backward, reverse, backwardVisited,
+                                forwardVisited, numThreads, met);
+      backwardDepth++;
+    }
+    if (met) return forwardDepth + backwardDepth;
+  }
+
+  return -1;
+}
+
+// Replays the recursive strategy on the loaded graph, checking that every
+// move follows an edge and never places a disk on a smaller one. Returns
+// its move count, or -1 if the strategy does not apply to this graph.
+long long recursiveMoveCount(const PegAdjacencyList& list, int n) {
+  try {
+    PegGraph graph = PegGraph::fromAdjacencyList(list);
+    HanoiMoveGenerator generator(graph, n);
+    std::vector<std::vector<int>> towers(NumPegs);
+    for (int i = n; i > 0; --i) {
+      towers[Start].push_back(i);
+    }
+
+    Move move;
+    long long moveCount = 0;
+    while (generator.next(move)) {
+      std::vector<int>& src = towers[move.src];
+      std::vector<int>& dst = towers[move.dst];
+      if (!(graph.adjacency[move.src] & pegBit(move.dst)) || src.empty() ||
+          src.back() != move.disk || (!dst.empty() && dst.back() < move.disk)) {
+        return -1;
+      }
+      src.pop_back();
+      dst.push_back(move.disk);
+      moveCount++;
+    }
+    return towers[Dest].size() == size_t(n) ? moveCount : -1;
+  } catch (const std::logic_error&) {
+    return -1;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <graph-file> <maxN>"
+              << " [--from Start] [--to Dest] [--threads T]" << std::endl;
+    return 1;
+  }
+
+  std::string srcName = "Start", dstName = "Dest";
+  int maxN = std::stoi(argv[2]);
+  int numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (int i = 3; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    if (arg == "--from") srcName = argv[i + 1];
+    else if (arg == "--to") dstName = argv[i + 1];
+    else if (arg == "--threads") numThreads = std::stoi(argv[i + 1]);
+  }
+
+  PegAdjacencyList graph;
+  try {
+    graph = PegAdjacencyList::load(argv[1]);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  int src = graph.find(srcName), dst = graph.find(dstName);
+  if (src < 0 || dst < 0 || graph.names.size() < 2) {
+    std::cerr << "Graph needs pegs " << srcName << " and " << dstName << std::endl;
+    return 1;
+  }
+  // The recursive strategy always solves Start to Dest
+  bool compareRecursive = srcName == "Start" && dstName == "Dest";
+
+  std::cout << "Optimal moves on " << argv[1] << " (" << graph.names.size()
+            << " pegs, " << numThreads << " threads)\n";
+  std::cout << "--------------------------------------------------------------------\n";
+  std::cout << std::setw(4) << std::right << "n" << " | "
+            << std::setw(12) << std::right << "Optimal" << " | "
+            << std::setw(12) << std::right << "Recursive" << " | "
+            << std::setw(10) << std::right << "Optimal?" << " | "
+            << std::setw(12) << std::right << "Time (ms)" << std::endl;
+  std::cout << "--------------------------------------------------------------------\n";
+
+  for (int n = 1; n <= maxN; n++) {
+    auto start = std::chrono::high_resolution_clock::now();
+    long long optimal;
+    try {
+      optimal = bidirectionalBfs(graph, n, src, dst, numThreads);
+    } catch (const std::exception& e) {
+      std::cerr << "n = " << n << ": " << e.what() << std::endl;
+      return 1;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    long long recursive = compareRecursive ? recursiveMoveCount(graph, n) : -1;
+    std::string verdict = recursive < 0 ? "-" : recursive == optimal ? "yes" : "no";
+
+    std::cout << std::setw(4) << std::right << n << " | "
+              << std::setw(12) << std::right << optimal << " | "
+              << std::setw(12) << std::right
+              << (recursive < 0 ? "-" : std::to_string(recursive)) << " | "
+              << std::setw(10) << std::right << verdict << " | "
+              << std::setw(12) << std::right << std::fixed << std::setprecision(3)
+              << std::chrono::duration<double, std::milli>(end - start).count()
+              << std::endl;
+  }
+
+  std::cout << "--------------------------------------------------------------------\n";
+  return 0;
+}
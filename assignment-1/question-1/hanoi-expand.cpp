@@ -0,0 +1,87 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cstdio>
+
+#include "hanoi.h"
+
+// Expands a binary move log written by BinaryMoveSink back into the text
+// format, replaying the towers to recover each disk
+void expandBinaryLog(const std::string& inputName, const std::string& outputName) {
+  std::FILE* input = std::fopen(inputName.c_str(), "rb");
+  if (!input) {
+    throw std::runtime_error("Failed to open input file");
+  }
+
+  uint8_t header[binaryHeaderSize];
+  if (std::fread(header, 1, binaryHeaderSize, input) != binaryHeaderSize ||
+      std::memcmp(header, binaryMagic, sizeof(binaryMagic)) != 0 ||
+      header[5] != NumPegs) {
+    std::fclose(input);
+    throw std::runtime_error("Not a Hanoi binary move log");
+  }
+  int n = header[4];
+
+  std::vector<std::vector<int>> towers(NumPegs);
+  for (int i = n; i > 0; --i) {
+    towers[Start].push_back(i);
+  }
+
+  TextMoveSink sink(outputName);
+  sink.begin(n);
+
+  std::vector<uint8_t> buffer(1 << 20);
+  long long moveCount = 0;
+  int prevDisk = 0;
+  size_t bytesRead;
+
+  while ((bytesRead = std::fread(buffer.data(), 1, buffer.size(), input)) > 0) {
+    for (size_t i = 0; i < bytesRead; i++) {
+      uint8_t code = buffer[i];
+      int src = binaryMoveSrc(code);
+      int dst = binaryMoveDst(code);
+      if (src >= NumPegs || dst >= NumPegs || towers[src].empty()) {
+        std::fclose(input);
+        throw std::logic_error("Cannot move from empty tower");
+      }
+
+      int disk = towers[src].back();
+      if (!towers[dst].empty() && towers[dst].back() < disk) {
+        std::fclose(input);
+        throw std::logic_error("Cannot place disk on smaller disk");
+      }
+
+      int delta = binaryMoveDelta(code);
+      if (delta != binaryDeltaEscape && prevDisk + delta != disk) {
+        std::fclose(input);
+        throw std::runtime_error("Corrupt move log at move "
+                                 + std::to_string(moveCount + 1));
+      }
+
+      towers[src].pop_back();
+      towers[dst].push_back(disk);
+      prevDisk = disk;
+      sink.move(++moveCount, disk, src, dst);
+    }
+  }
+
+  std::fclose(input);
+  sink.end(moveCount);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <input.bin> <output.txt>" << std::endl;
+    return 1;
+  }
+
+  try {
+    expandBinaryLog(argv[1], argv[2]);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,683 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <charconv>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Peg IDs are ordered by name, so the lowest set bit of a peg mask is the
+// same peg the old std::set<std::string> lookups picked with begin()
+enum Peg : int { A1, A2, A3, Dest, Start, NumPegs };
+const char* const pegNames[NumPegs] = {"A1", "A2", "A3", "Dest", "Start"};
+
+using PegMask = uint32_t;
+
+constexpr PegMask pegBit(int peg) { return PegMask(1) << peg; }
+
+// Peg graph read from a file, with any peg names. Each non-empty line that
+// does not start with '#' lists a peg and its neighbors, e.g.
+//   A1: Start Dest A3
+struct PegAdjacencyList {
+  static constexpr int maxPegs = 16;
+
+  std::vector<std::string> names;
+  std::vector<PegMask> adjacency;
+
+  int find(const std::string& name) const {
+    for (size_t i = 0; i < names.size(); i++) {
+      if (names[i] == name) return i;
+    }
+    return -1;
+  }
+
+  int findOrAdd(const std::string& name) {
+    int peg = find(name);
+    if (peg >= 0) return peg;
+    if (names.size() == maxPegs) {
+      throw std::runtime_error("Too many pegs in graph");
+    }
+    names.push_back(name);
+    adjacency.push_back(0);
+    return names.size() - 1;
+  }
+
+  static PegAdjacencyList load(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+      throw std::runtime_error("Failed to open graph file");
+    }
+
+    PegAdjacencyList list;
+    std::string line;
+    while (std::getline(file, line)) {
+      size_t colon = line.find(':');
+      if (line.empty() || line[0] == '#') continue;
+      if (colon == std::string::npos) {
+        throw std::runtime_error("Expected 'peg: neighbors' in graph file");
+      }
+
+      std::istringstream pegName(line.substr(0, colon));
+      std::istringstream neighbors(line.substr(colon + 1));
+      std::string name;
+      pegName >> name;
+      int peg = list.findOrAdd(name);
+      while (neighbors >> name) {
+        int neighbor = list.findOrAdd(name);
+        list.adjacency[peg] |= pegBit(neighbor);
+      }
+    }
+    return list;
+  }
+};
+
+// Adjacency bitmasks plus the auxiliary peg for every (src, dst) pair
+struct PegGraph {
+  PegMask adjacency[NumPegs];
+  int auxAdjacent[NumPegs][NumPegs];     // -1 if none
+  int auxNonAdjacent[NumPegs][NumPegs];  // -1 if none
+
+  static PegGraph standard() {
+    PegGraph g;
+    g.adjacency[Start] = pegBit(A1);
+    g.adjacency[A1] = pegBit(Start) | pegBit(Dest) | pegBit(A3);
+    g.adjacency[A2] = pegBit(Dest) | pegBit(A3);
+    g.adjacency[A3] = pegBit(A2) | pegBit(A1);
+    g.adjacency[Dest] = pegBit(A1) | pegBit(A2);
+    g.computeAuxPegs();
+    return g;
+  }
+
+  // Only graphs over the standard peg names can drive the recursive solver
+  static PegGraph fromAdjacencyList(const PegAdjacencyList& list) {
+    PegGraph g;
+    std::fill(std::begin(g.adjacency), std::end(g.adjacency), 0);
+    for (size_t i = 0; i < list.names.size(); i++) {
+      int peg = pegId(list.names[i]);
+      for (size_t j = 0; j < list.names.size(); j++) {
+        if (list.adjacency[i] & pegBit(j)) {
+          g.adjacency[peg] |= pegBit(pegId(list.names[j]));
+        }
+      }
+    }
+    g.computeAuxPegs();
+    return g;
+  }
+
+  static int pegId(const std::string& name) {
+    for (int peg = 0; peg < NumPegs; peg++) {
+      if (name == pegNames[peg]) return peg;
+    }
+    throw std::invalid_argument("Unknown peg: " + name);
+  }
+
+  void computeAuxPegs() {
+    for (int src = 0; src < NumPegs; src++) {
+      for (int dst = 0; dst < NumPegs; dst++) {
+        PegMask adjacentCandidates = adjacency[dst] & ~pegBit(src);
+        PegMask commonNeighbors = adjacency[src] & adjacency[dst];
+        auxAdjacent[src][dst] = 
+          adjacentCandidates ? std::countr_zero(adjacentCandidates) : -1;
+        auxNonAdjacent[src][dst] = 
+          commonNeighbors ? std::countr_zero(commonNeighbors) : -1;
+      }
+    }
+  }
+
+  int adjacentAux(int src, int dst) const {
+    int aux = auxAdjacent[src][dst];
+    if (aux < 0) {
+      throw std::logic_error("No valid auxiliary peg found");
+    }
+    return aux;
+  }
+
+  int nonAdjacentAux(int src, int dst) const {
+    int aux = auxNonAdjacent[src][dst];
+    if (aux < 0) {
+      throw std::logic_error(std::string("No path of length 2 between ") 
+                             + pegNames[src] + " and " + pegNames[dst]);
+    }
+    return aux;
+  }
+};
+
+struct Move {
+  int disk;
+  int src;
+  int dst;
+};
+
+// Move counts of the three recursive procedures, which depend only on the
+// number of disks. startToDest(n) makes 3^n - 1 moves, so n <= 39 keeps
+// every count in a long long.
+struct HanoiMoveCounts {
+  static constexpr int maxDisks = 39;
+
+  long long startToDest[maxDisks + 1];
+  long long adjacent[maxDisks + 1];
+  long long nonAdjacent[maxDisks + 1];
+
+  HanoiMoveCounts() {
+    startToDest[0] = adjacent[0] = nonAdjacent[0] = 0;
+    for (int n = 1; n <= maxDisks; n++) {
+      adjacent[n] = nonAdjacent[n - 1] + 1 + adjacent[n - 1];
+      nonAdjacent[n] = 2 * adjacent[n];
+      startToDest[n] = startToDest[n - 1] + 2 * nonAdjacent[n - 1] + 2;
+    }
+  }
+};
+
+// Non-recursive equivalent of HanoiGraphSolver's startToDest, moveAdjacent
+// and moveNonAdjacent. next() walks the same call tree with an explicit
+// stack of O(n) frames, and moveAt()/seek() descend straight to move k in
+// O(n) using the subtree move counts. Move numbers are 1-based, as in the
+// text output.
+class HanoiMoveGenerator {
+public:
+  HanoiMoveGenerator(const PegGraph& graph, int n) : graph(graph), _n(n) {
+    if (n < 0 || n > HanoiMoveCounts::maxDisks) {
+      throw std::invalid_argument("Disk count out of range");
+    }
+    stack.reserve(3 * n + 2);
+    seek(1);
+  }
+
+  long long totalMoves() const { return counts.startToDest[_n]; }
+
+  // Next move number next() will return
+  long long position() const { return nextMoveNumber; }
+
+  bool next(Move& move) {
+    while (!stack.empty()) {
+      Frame& f = stack.back();
+      switch (f.kind) {
+        case StartToDest:
+          switch (f.stage++) {
+            case 0: push(StartToDest, f.n - 1, Start, Dest); continue;
+            case 1: push(NonAdjacent, f.n - 1, Dest, A3); continue;
+            case 2: return emit(move, f.n, Start, A1);
+            case 3: return emit(move, f.n, A1, Dest);
+            case 4: tailCall(NonAdjacent, f.n - 1, A3, Dest); continue;
+          }
+          break;
+        case Adjacent:
+          switch (f.stage++) {
+            case 0: push(NonAdjacent, f.n - 1, f.src, f.aux); continue;
+            case 1: return emit(move, f.n, f.src, f.dst);
+            case 2: tailCall(Adjacent, f.n - 1, f.aux, f.dst); continue;
+          }
+          break;
+        case NonAdjacent:
+          switch (f.stage++) {
+            case 0: push(Adjacent, f.n, f.src, f.aux); continue;
+            case 1: tailCall(Adjacent, f.n, f.aux, f.dst); continue;
+          }
+          break;
+      }
+      stack.pop_back();
+    }
+    return false;
+  }
+
+  // Computes move k without generating the earlier ones
+  Move moveAt(long long k) const {
+    if (k < 1 || k > totalMoves()) {
+      throw std::out_of_range("Move number out of range");
+    }
+
+    long long idx = k - 1;
+    int kind = StartToDest, n = _n, src = Start, dst = Dest;
+    while (true) {
+      if (kind == StartToDest) {
+        if (idx < counts.startToDest[n - 1]) { n--; continue; }
+        idx -= counts.startToDest[n - 1];
+        if (idx < counts.nonAdjacent[n - 1]) {
+          kind = NonAdjacent; n--; src = Dest; dst = A3; continue;
+        }
+        idx -= counts.nonAdjacent[n - 1];
+        if (idx == 0) return {n, Start, A1};
+        if (idx == 1) return {n, A1, Dest};
+        idx -= 2;
+        kind = NonAdjacent; n--; src = A3; dst = Dest;
+      } else if (kind == Adjacent) {
+        int aux = graph.adjacentAux(src, dst);
+        if (idx < counts.nonAdjacent[n - 1]) {
+          kind = NonAdjacent; n--; dst = aux; continue;
+        }
+        idx -= counts.nonAdjacent[n - 1];
+        if (idx == 0) return {n, src, dst};
+        idx -= 1;
+        n--; src = aux;
+      } else {
+        int aux = graph.nonAdjacentAux(src, dst);
+        kind = Adjacent;
+        if (idx < counts.adjacent[n]) {
+          dst = aux;
+        } else {
+          idx -= counts.adjacent[n];
+          src = aux;
+        }
+      }
+    }
+  }
+
+  // Positions the generator so that next() returns move k; k past the end
+  // leaves it exhausted
+  void seek(long long k) {
+    stack.clear();
+    nextMoveNumber = k;
+    if (k < 1 || k > totalMoves()) return;
+
+    // Same descent as moveAt, leaving each frame at the stage that follows
+    // the child being entered
+    long long idx = k - 1;
+    push(StartToDest, _n, Start, Dest);
+    while (true) {
+      Frame& f = stack.back();
+      int n = f.n;
+      if (f.kind == StartToDest) {
+        if (idx < counts.startToDest[n - 1]) {
+          f.stage = 1; push(StartToDest, n - 1, Start, Dest); continue;
+        }
+        idx -= counts.startToDest[n - 1];
+        if (idx < counts.nonAdjacent[n - 1]) {
+          f.stage = 2; push(NonAdjacent, n - 1, Dest, A3); continue;
+        }
+        idx -= counts.nonAdjacent[n - 1];
+        if (idx < 2) { f.stage = 2 + idx; return; }
+        idx -= 2;
+        f.stage = 5; push(NonAdjacent, n - 1, A3, Dest);
+      } else if (f.kind == Adjacent) {
+        if (idx < counts.nonAdjacent[n - 1]) {
+          f.stage = 1; push(NonAdjacent, n - 1, f.src, f.aux); continue;
+        }
+        idx -= counts.nonAdjacent[n - 1];
+        if (idx == 0) { f.stage = 1; return; }
+        idx -= 1;
+        f.stage = 3; push(Adjacent, n - 1, f.aux, f.dst);
+      } else {
+        if (idx < counts.adjacent[n]) {
+          f.stage = 1; push(Adjacent, n, f.src, f.aux); continue;
+        }
+        idx -= counts.adjacent[n];
+        f.stage = 2; push(Adjacent, n, f.aux, f.dst);
+      }
+    }
+  }
+
+private:
+  enum FrameKind { StartToDest, Adjacent, NonAdjacent };
+
+  struct Frame {
+    int kind;
+    int n;
+    int src;
+    int dst;
+    int aux;
+    int stage;
+  };
+
+  // Frames for zero disks make no moves and are never pushed
+  void push(int kind, int n, int src, int dst) {
+    if (n == 0) return;
+    int aux = -1;
+    if (kind == Adjacent) aux = graph.adjacentAux(src, dst);
+    if (kind == NonAdjacent) aux = graph.nonAdjacentAux(src, dst);
+    stack.push_back({kind, n, src, dst, aux, 0});
+  }
+
+  // Replaces the finished top frame with its last child
+  void tailCall(int kind, int n, int src, int dst) {
+    stack.pop_back();
+    push(kind, n, src, dst);
+  }
+
+  bool emit(Move& move, int disk, int src, int dst) {
+    move = {disk, src, dst};
+    nextMoveNumber++;
+    return true;
+  }
+
+  PegGraph graph;
+  HanoiMoveCounts counts;
+  int _n;
+  long long nextMoveNumber = 1;
+  std::vector<Frame> stack;
+};
+
+// Text format line for one move; never longer than maxMoveLineSize
+constexpr size_t maxMoveLineSize = 128;
+
+inline char* appendText(char* out, const char* s) {
+  size_t len = std::strlen(s);
+  std::memcpy(out, s, len);
+  return out + len;
+}
+
+inline char* formatMoveLine(char* out, long long moveNumber, 
+                            int disk, int src, int dst) {
+  out = appendText(out, "Move ");
+  out = std::to_chars(out, out + 20, moveNumber).ptr;
+  out = appendText(out, ": Move disk ");
+  out = std::to_chars(out, out + 20, disk).ptr;
+  out = appendText(out, " from ");
+  out = appendText(out, pegNames[src]);
+  out = appendText(out, " to ");
+  out = appendText(out, pegNames[dst]);
+  *out++ = '\n';
+  return out;
+}
+
+inline std::string solveHeaderLine(int n) {
+  return "Solving Towers of Hanoi for " + std::to_string(n) + " disks\n";
+}
+
+inline std::string totalMovesLine(long long totalMoves) {
+  return "Total moves: " + std::to_string(totalMoves) + "\n";
+}
+
+// Byte layout of the text output, so any range of moves can be written
+// straight to its final offset. Every line is "Move <k>: Move disk <d> from
+// <src> to <dst>\n"; the bytes of each recursive call's lines, excluding the
+// move numbers, are tabulated per (n, src, dst), and the move number digits
+// have a closed form.
+class HanoiTextLayout {
+public:
+  HanoiTextLayout(const PegGraph& graph, int n) 
+    : graph(graph), _n(n), header(solveHeaderLine(n)) {
+    HanoiMoveGenerator generator(graph, n);
+    totalMoves = generator.totalMoves();
+    // Lines are under 64 bytes, which bounds n at about 35
+    if (totalMoves > std::numeric_limits<long long>::max() / 64) {
+      throw std::invalid_argument("Too many disks for a text layout");
+    }
+
+    std::fill(&adjacentBytes[0][0][0], &adjacentBytes[0][0][0] + tableSize, -1);
+    std::fill(&nonAdjacentBytes[0][0][0], &nonAdjacentBytes[0][0][0] + tableSize, -1);
+    startToDestBytes[0] = 0;
+    for (int i = 1; i <= n; i++) {
+      startToDestBytes[i] = startToDestBytes[i - 1]
+        + nonAdjacentSubtreeBytes(i - 1, Dest, A3)
+        + lineBytes(i, Start, A1) + lineBytes(i, A1, Dest)
+        + nonAdjacentSubtreeBytes(i - 1, A3, Dest);
+    }
+  }
+
+  const std::string& headerLine() const { return header; }
+
+  // Offset of the line for move k; k = totalMoves + 1 gives the footer
+  long long moveOffset(long long k) const {
+    return header.size() + moveNumberDigits(k - 1) + bytesBefore(k - 1);
+  }
+
+  long long fileSize() const {
+    return moveOffset(totalMoves + 1) + totalMovesLine(totalMoves).size();
+  }
+
+private:
+  static constexpr size_t tableSize = 
+    (HanoiMoveCounts::maxDisks + 1) * NumPegs * NumPegs;
+
+  static long long digits(long long value) {
+    long long count = 1;
+    while (value >= 10) { value /= 10; count++; }
+    return count;
+  }
+
+  // Total digits in the move numbers 1..k
+  static long long moveNumberDigits(long long k) {
+    long long sum = 0;
+    for (long long lo = 1, width = 1; lo <= k; lo *= 10, width++) {
+      long long hi = std::min(k, lo * 10 - 1);
+      sum += (hi - lo + 1) * width;
+      if (lo > k / 10) break;
+    }
+    return sum;
+  }
+
+  // Line bytes excluding the move number
+  static long long lineBytes(int disk, int src, int dst) {
+    return std::strlen("Move : Move disk  from  to \n") + digits(disk)
+      + std::strlen(pegNames[src]) + std::strlen(pegNames[dst]);
+  }
+
+  long long adjacentSubtreeBytes(int n, int src, int dst) {
+    if (n == 0) return 0;
+    long long& bytes = adjacentBytes[n][src][dst];
+    if (bytes < 0) {
+      int aux = graph.adjacentAux(src, dst);
+      bytes = nonAdjacentSubtreeBytes(n - 1, src, aux) + lineBytes(n, src, dst)
+        + adjacentSubtreeBytes(n - 1, aux, dst);
+    }
+    return bytes;
+  }
+
+  long long nonAdjacentSubtreeBytes(int n, int src, int dst) {
+    if (n == 0) return 0;
+    long long& bytes = nonAdjacentBytes[n][src][dst];
+    if (bytes < 0) {
+      int aux = graph.nonAdjacentAux(src, dst);
+      bytes = adjacentSubtreeBytes(n, src, aux) + adjacentSubtreeBytes(n, aux, dst);
+    }
+    return bytes;
+  }
+
+  // Bytes of the first k moves excluding move numbers, found with the same
+  // descent as HanoiMoveGenerator::moveAt
+  long long bytesBefore(long long k) const {
+    if (k >= totalMoves) return startToDestBytes[_n];
+
+    long long bytes = 0;
+    int kind = 0, n = _n, src = Start, dst = Dest;
+    while (k > 0) {
+      if (kind == 0) {
+        if (k < counts.startToDest[n - 1]) { n--; continue; }
+        k -= counts.startToDest[n - 1];
+        bytes += startToDestBytes[n - 1];
+        if (k < counts.nonAdjacent[n - 1]) {
+          kind = 2; n--; src = Dest; dst = A3; continue;
+        }
+        k -= counts.nonAdjacent[n - 1];
+        bytes += nonAdjacentBytesAt(n - 1, Dest, A3);
+        if (k == 0) break;
+        bytes += lineBytes(n, Start, A1);
+        if (k == 1) break;
+        bytes += lineBytes(n, A1, Dest);
+        k -= 2;
+        kind = 2; n--; src = A3; dst = Dest;
+      } else if (kind == 1) {
+        int aux = graph.adjacentAux(src, dst);
+        if (k < counts.nonAdjacent[n - 1]) {
+          kind = 2; n--; dst = aux; continue;
+        }
+        k -= counts.nonAdjacent[n - 1];
+        bytes += nonAdjacentBytesAt(n - 1, src, aux);
+        if (k == 0) break;
+        bytes += lineBytes(n, src, dst);
+        k -= 1;
+        n--; src = aux;
+      } else {
+        int aux = graph.nonAdjacentAux(src, dst);
+        kind = 1;
+        if (k < counts.adjacent[n]) {
+          dst = aux;
+        } else {
+          k -= counts.adjacent[n];
+          bytes += adjacentBytesAt(n, src, aux);
+          src = aux;
+        }
+      }
+    }
+    return bytes;
+  }
+
+  long long adjacentBytesAt(int n, int src, int dst) const {
+    return n == 0 ? 0 : adjacentBytes[n][src][dst];
+  }
+
+  long long nonAdjacentBytesAt(int n, int src, int dst) const {
+    return n == 0 ? 0 : nonAdjacentBytes[n][src][dst];
+  }
+
+  PegGraph graph;
+  HanoiMoveCounts counts;
+  int _n;
+  long long totalMoves;
+  std::string header;
+  long long startToDestBytes[HanoiMoveCounts::maxDisks + 1];
+  long long adjacentBytes[HanoiMoveCounts::maxDisks + 1][NumPegs][NumPegs];
+  long long nonAdjacentBytes[HanoiMoveCounts::maxDisks + 1][NumPegs][NumPegs];
+};
+
+// Receives every move of a solve, in order
+class MoveSink {
+public:
+  virtual ~MoveSink() = default;
+  virtual void begin(int /*n*/) {}
+  virtual void move(long long moveNumber, int disk, int src, int dst) = 0;
+  virtual void end(long long /*totalMoves*/) {}
+};
+
+// Writes the text format through a large buffer, flushing only when full
+class TextMoveSink : public MoveSink {
+public:
+  static constexpr size_t bufferSize = 1 << 20;
+
+  TextMoveSink(const std::string& filename) {
+    file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+      throw std::runtime_error("Failed to open output file");
+    }
+    buffer.resize(bufferSize);
+  }
+
+  // end() flushes and reports write errors. A destructor must not throw,
+  // so whatever an abandoned solve left buffered is written best effort.
+  ~TextMoveSink() {
+    if (used > 0) std::fwrite(buffer.data(), 1, used, file);
+    std::fclose(file);
+  }
+
+  void begin(int n) override { append(solveHeaderLine(n)); }
+
+  void move(long long moveNumber, int disk, int src, int dst) override {
+    if (used + maxMoveLineSize > buffer.size()) flush();
+    char* end = formatMoveLine(buffer.data() + used, moveNumber, disk, src, dst);
+    used = end - buffer.data();
+  }
+
+  void end(long long totalMoves) override {
+    append(totalMovesLine(totalMoves));
+    flush();
+    if (std::fflush(file) != 0) throw std::runtime_error("Failed to write output file");
+  }
+
+private:
+  void flush() {
+    if (used > 0 && std::fwrite(buffer.data(), 1, used, file) != used) {
+      throw std::runtime_error("Failed to write output file");
+    }
+    used = 0;
+  }
+
+  void append(const std::string& s) {
+    if (used + s.size() > buffer.size()) flush();
+    std::memcpy(buffer.data() + used, s.data(), s.size());
+    used += s.size();
+  }
+
+  std::FILE* file;
+  std::vector<char> buffer;
+  size_t used = 0;
+};
+
+// Binary move log: a 6-byte header ("HANB", disk count, peg count) followed
+// by one byte per move. The low 5 bits hold src * NumPegs + dst and the high
+// 3 bits hold the signed change in disk number from the previous move, or
+// binaryDeltaEscape when it does not fit. The disk itself is always
+// recoverable by replaying the towers, so the delta only serves as a check.
+constexpr char binaryMagic[4] = {'H', 'A', 'N', 'B'};
+constexpr size_t binaryHeaderSize = 6;
+constexpr int binaryDeltaEscape = -4;
+
+inline uint8_t encodeBinaryMove(int prevDisk, int disk, int src, int dst) {
+  int delta = disk - prevDisk;
+  if (delta < -3 || delta > 3) delta = binaryDeltaEscape;
+  return uint8_t(((delta & 7) << 5) | (src * NumPegs + dst));
+}
+
+inline int binaryMoveSrc(uint8_t code) { return (code & 31) / NumPegs; }
+inline int binaryMoveDst(uint8_t code) { return (code & 31) % NumPegs; }
+inline int binaryMoveDelta(uint8_t code) {
+  int delta = code >> 5;
+  return delta >= 4 ? delta - 8 : delta;
+}
+
+class BinaryMoveSink : public MoveSink {
+public:
+  static constexpr size_t bufferSize = 1 << 20;
+
+  BinaryMoveSink(const std::string& filename) {
+    file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+      throw std::runtime_error("Failed to open output file");
+    }
+    buffer.resize(bufferSize);
+  }
+
+  // end() flushes and reports write errors. A destructor must not throw,
+  // so whatever an abandoned solve left buffered is written best effort.
+  ~BinaryMoveSink() {
+    if (used > 0) std::fwrite(buffer.data(), 1, used, file);
+    std::fclose(file);
+  }
+
+  void begin(int n) override {
+    std::memcpy(buffer.data(), binaryMagic, sizeof(binaryMagic));
+    buffer[4] = uint8_t(n);
+    buffer[5] = uint8_t(NumPegs);
+    used = binaryHeaderSize;
+  }
+
+  void move(long long /*moveNumber*/, int disk, int src, int dst) override {
+    if (used == buffer.size()) flush();
+    buffer[used++] = encodeBinaryMove(prevDisk, disk, src, dst);
+    prevDisk = disk;
+  }
+
+  void end(long long /*totalMoves*/) override {
+    flush();
+    if (std::fflush(file) != 0) throw std::runtime_error("Failed to write output file");
+  }
+
+private:
+  void flush() {
+    if (used > 0 && std::fwrite(buffer.data(), 1, used, file) != used) {
+      throw std::runtime_error("Failed to write output file");
+    }
+    used = 0;
+  }
+
+  std::FILE* file;
+  std::vector<uint8_t> buffer;
+  size_t used = 0;
+  int prevDisk = 0;
+};
+
+// Only counts moves, for benchmarking the solver itself
+class NullMoveSink : public MoveSink {
+public:
+  void move(long long /*moveNumber*/, int /*disk*/, int /*src*/, int /*dst*/) override {
+    moves++;
+  }
+
+  long long moves = 0;
+};
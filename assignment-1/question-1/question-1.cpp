@@ -1,95 +1,78 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <map>
-#include <set>
 #include <numeric>
 #include <algorithm>
 #include <stdexcept>
 #include <cmath>
 #include <fstream>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <iomanip>
+#include <exception>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "hanoi.h"
+#include "../../common/bench.h"
 
 class HanoiGraphSolver {
 public:
-  HanoiGraphSolver(int n, const std::string& filename) : _n(n), moveCount(0) {
-    // Open output file
-    outputFile.open(filename);
-    if (!outputFile.is_open()) {
-      throw std::runtime_error("Failed to open output file");
-    }
-
-    // Define the graph using an adjacency list 
-    graph["Start"] = {"A1"};
-    graph["A1"] = {"Start", "Dest", "A3"};
-    graph["A2"] = {"Dest", "A3"};
-    graph["A3"] = {"A2", "A1"};
-    graph["Dest"] = {"A1", "A2"};
-
-    // Initialize towers
-    for (const auto& pair : graph) {
-      towers[pair.first] = {};
-    }
+  HanoiGraphSolver(int n, MoveSink& sink) 
+    : _n(n), moveCount(0), graph(PegGraph::standard()), sink(sink) {
+    // Initialize towers, each with room for all n disks
+    towerDisks.assign(NumPegs * std::max(_n, 1), 0);
+    std::fill(std::begin(towerHeight), std::end(towerHeight), 0);
 
     // Place disks on the Start tower
     for (int i = _n; i > 0; --i) {
-      towers["Start"].push_back(i);
-    }
-  }
-
-  ~HanoiGraphSolver() {
-    if (outputFile.is_open()) {
-      outputFile.close();
+      pushDisk(Start, i);
     }
   }
 
   void solve() {
-    outputFile << "Solving Towers of Hanoi for " << _n << " disks" << std::endl;
+    sink.begin(_n);
     startToDest(_n);
-    outputFile << "Total moves: " << moveCount << std::endl;
+    sink.end(moveCount);
   }
 
+  long long getMoveCount() const { return moveCount; }
+
 private:
-  void moveDisk(const std::string& src, const std::string& dst) {
-    if (towers.at(src).empty()) {
+  int* tower(int peg) { return towerDisks.data() + peg * std::max(_n, 1); }
+
+  void pushDisk(int peg, int disk) { tower(peg)[towerHeight[peg]++] = disk; }
+
+  void moveDisk(int src, int dst) {
+    if (towerHeight[src] == 0) {
       throw std::logic_error("Cannot move from empty tower");
     }
     
-    int disk = towers.at(src).back();
-    towers.at(src).pop_back();
+    int disk = tower(src)[--towerHeight[src]];
     
-    if (!towers.at(dst).empty() && towers.at(dst).back() < disk) {
+    if (towerHeight[dst] != 0 && tower(dst)[towerHeight[dst] - 1] < disk) {
       throw std::logic_error("Cannot place disk on smaller disk");
     }
 
-    towers.at(dst).push_back(disk);
+    pushDisk(dst, disk);
     moveCount++;
-    outputFile << "Move " << moveCount 
-              << ": Move disk " << disk << " from " << src 
-              << " to " << dst << std::endl;
+    sink.move(moveCount, disk, src, dst);
   }
 
   void startToDest(int n) {
     if (n == 0) return;
     startToDest(n - 1);
-    moveNonAdjacent(n - 1, "Dest", "A3");
-    moveDisk("Start", "A1");
-    moveDisk("A1", "Dest");
-    moveNonAdjacent(n - 1, "A3", "Dest");
+    moveNonAdjacent(n - 1, Dest, A3);
+    moveDisk(Start, A1);
+    moveDisk(A1, Dest);
+    moveNonAdjacent(n - 1, A3, Dest);
   }
 
-  void moveAdjacent(int n, const std::string& src, const std::string& dst) {
+  void moveAdjacent(int n, int src, int dst) {
     if (n == 0) return;
 
-    std::set<std::string> auxCandidates;
-    std::set<std::string> srcSet = {src};
-    std::set_difference(graph.at(dst).begin(), graph.at(dst).end(),
-                        srcSet.begin(), srcSet.end(),
-                        std::inserter(auxCandidates, auxCandidates.begin()));
-
-    if (auxCandidates.empty()) {
-      throw std::logic_error("No valid auxiliary peg found");
-    }
-    std::string aux = *auxCandidates.begin();
+    int aux = graph.adjacentAux(src, dst);
 
     moveNonAdjacent(n - 1, src, aux);
     moveDisk(src, dst);
@@ -97,18 +80,10 @@ private:
   }
 
 
-  void moveNonAdjacent(int n, const std::string& src, const std::string& dst) {
+  void moveNonAdjacent(int n, int src, int dst) {
     if (n == 0) return;
     
-    std::set<std::string> neighbors;
-    std::set_intersection(graph.at(src).begin(), graph.at(src).end(),
-                          graph.at(dst).begin(), graph.at(dst).end(),
-                          std::inserter(neighbors, neighbors.begin()));
-
-    if (neighbors.empty()) {
-      throw std::logic_error("No path of length 2 between " + src + " and " + dst);
-    }
-    std::string aux = *neighbors.begin();
+    int aux = graph.nonAdjacentAux(src, dst);
 
     moveAdjacent(n, src, aux);
     moveAdjacent(n, aux, dst);
@@ -116,20 +91,277 @@ private:
 
   int _n;
   long long moveCount;
-  std::map<std::string, std::set<std::string>> graph;
-  std::map<std::string, std::vector<int>> towers;
-  std::ofstream outputFile;
+  PegGraph graph;
+  // Tower p occupies towerDisks[p * n, p * n + towerHeight[p])
+  std::vector<int> towerDisks;
+  int towerHeight[NumPegs];
+  MoveSink& sink;
 };
 
-int main() {
-  std::vector<int> nValues = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+// Same solve as HanoiGraphSolver::solve, driven by the iterative generator
+long long solveIterative(int n, MoveSink& sink) {
+  HanoiMoveGenerator generator(PegGraph::standard(), n);
+  Move move;
+  long long moveCount = 0;
+
+  sink.begin(n);
+  while (generator.next(move)) {
+    sink.move(++moveCount, move.disk, move.src, move.dst);
+  }
+  sink.end(moveCount);
+  return moveCount;
+}
+
+// Checks every move of the recursive solver against next(), moveAt() and
+// seek() of HanoiMoveGenerator
+class GeneratorCheckSink : public MoveSink {
+public:
+  GeneratorCheckSink(int n) 
+    : sequential(PegGraph::standard(), n), seeking(PegGraph::standard(), n) {}
+
+  void move(long long moveNumber, int disk, int src, int dst) override {
+    Move next, seeked;
+    Move direct = sequential.moveAt(moveNumber);
+    seeking.seek(moveNumber);
+    if (!sequential.next(next) || !seeking.next(seeked) ||
+        !sameMove(next, disk, src, dst) || !sameMove(direct, disk, src, dst) ||
+        !sameMove(seeked, disk, src, dst)) {
+      throw std::logic_error("Generator disagrees with solver at move " 
+                             + std::to_string(moveNumber));
+    }
+  }
+
+  void end(long long totalMoves) override {
+    Move move;
+    if (totalMoves != sequential.totalMoves() || sequential.next(move)) {
+      throw std::logic_error("Generator move count disagrees with solver");
+    }
+  }
+
+private:
+  static bool sameMove(const Move& m, int disk, int src, int dst) {
+    return m.disk == disk && m.src == src && m.dst == dst;
+  }
+
+  HanoiMoveGenerator sequential;
+  HanoiMoveGenerator seeking;
+};
+
+bool verifyGenerator(int maxN) {
+  for (int n = 0; n <= maxN; n++) {
+    try {
+      GeneratorCheckSink sink(n);
+      HanoiGraphSolver solver(n, sink);
+      solver.solve();
+      std::cout << "n = " << n << ": " << solver.getMoveCount() 
+                << " moves match" << std::endl;
+    } catch (const std::exception& e) {
+      std::cerr << "n = " << n << ": " << e.what() << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Writes moves [first, last] at their final offsets in the output file
+void writeMoveRange(int fd, const HanoiTextLayout& layout, int n,
+                    long long first, long long last) {
+  HanoiMoveGenerator generator(PegGraph::standard(), n);
+  generator.seek(first);
+
+  std::vector<char> buffer(TextMoveSink::bufferSize);
+  long long offset = layout.moveOffset(first);
+  size_t used = 0;
+  Move move;
+
+  auto flush = [&]() {
+    if (pwrite(fd, buffer.data(), used, offset) != (ssize_t)used) {
+      throw std::runtime_error("Failed to write output file");
+    }
+    offset += used;
+    used = 0;
+  };
+
+  for (long long k = first; k <= last && generator.next(move); k++) {
+    if (used + maxMoveLineSize > buffer.size()) flush();
+    used = formatMoveLine(buffer.data() + used, k, move.disk, move.src, move.dst) 
+           - buffer.data();
+  }
+  flush();
+}
+
+// Splits the solve into one contiguous move range per thread; each thread
+// seeks its own generator and writes into a pre-sized region of the file
+long long solveParallel(int n, int numThreads, const std::string& filename) {
+  HanoiTextLayout layout(PegGraph::standard(), n);
+  long long totalMoves = HanoiMoveCounts().startToDest[n];
+
+  int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open output file");
+  }
+  if (ftruncate(fd, layout.fileSize()) != 0) {
+    close(fd);
+    throw std::runtime_error("Failed to size output file");
+  }
+
+  std::string header = layout.headerLine();
+  std::string footer = totalMovesLine(totalMoves);
+  if (pwrite(fd, header.data(), header.size(), 0) != (ssize_t)header.size() ||
+      pwrite(fd, footer.data(), footer.size(), layout.moveOffset(totalMoves + 1))
+        != (ssize_t)footer.size()) {
+    close(fd);
+    throw std::runtime_error("Failed to write output file");
+  }
+
+  std::vector<std::thread> workers;
+  std::vector<std::exception_ptr> errors(numThreads);
+  long long perThread = (totalMoves + numThreads - 1) / numThreads;
+
+  for (int t = 0; t < numThreads; t++) {
+    long long first = 1 + t * perThread;
+    long long last = std::min(totalMoves, first + perThread - 1);
+    if (first > last) break;
+    workers.emplace_back([&, t, first, last]() {
+      try {
+        writeMoveRange(fd, layout, n, first, last);
+      } catch (...) {
+        errors[t] = std::current_exception();
+      }
+    });
+  }
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  close(fd);
+
+  for (auto& error : errors) {
+    if (error) std::rethrow_exception(error);
+  }
+  return totalMoves;
+}
+
+// Median time of a parallel solve of n disks for thread counts 1, 2, 4, ... up to
+// the number of hardware threads
+void printParallelScaling(int n) {
+  int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::string filename = 
+    "hanoi_graph_solution_" + std::to_string(n) + "_disks.txt";
+  double baseTime = 0.0;
+
+  std::cout << "Parallel text output, n = " << n << "\n";
+  std::cout << "--------------------------------------------------------\n";
+  std::cout << std::setw(10) << std::right << "Threads" << " | "
+            << std::setw(15) << std::right << "Median (ms)" << " | "
+            << std::setw(15) << std::right << "Speedup" << std::endl;
+  std::cout << "--------------------------------------------------------\n";
+
+  // Each sample is one full solve
+  bench::Options opts;
+  opts.iterations = 1;
+  opts.minSamples = 3;
+  opts.maxSeconds = 0;
+  std::vector<bench::Result> results;
+
+  for (int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+    std::string name = "parallel/n=" + std::to_string(n) + "/threads=" + std::to_string(threads);
+    results.push_back(bench::run(name, [&]() {
+      solveParallel(n, threads, filename);
+    }, opts));
+    double ms = results.back().median * 1000.0;
+    if (threads == 1) baseTime = ms;
+
+    std::cout << std::setw(10) << std::right << threads << " | "
+              << std::setw(15) << std::right << std::fixed << std::setprecision(3) 
+              << ms << " | "
+              << std::setw(15) << std::right << baseTime / ms << std::endl;
+    if (threads == maxThreads) break;
+  }
+
+  std::cout << "--------------------------------------------------------\n\n";
+  bench::writeReports(results);
+}
+
+std::unique_ptr<MoveSink> makeSink(const std::string& kind, int n) {
+  std::string base = "hanoi_graph_solution_" + std::to_string(n) + "_disks";
+  if (kind == "text") return std::make_unique<TextMoveSink>(base + ".txt");
+  if (kind == "binary") return std::make_unique<BinaryMoveSink>(base + ".bin");
+  if (kind == "null") return std::make_unique<NullMoveSink>();
+  throw std::invalid_argument("Unknown sink: " + kind);
+}
+
+// Usage: question-1 [--sink text|binary|null] [--iterative] [n ...]
+//        question-1 --threads T [n ...]
+//        question-1 --scaling n
+//        question-1 --verify maxN
+int run(int argc, char* argv[]) {
+  std::string sinkKind = "text";
+  bool iterative = false;
+  int numThreads = 0;
+  std::vector<int> nValues;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--sink" && i + 1 < argc) {
+      sinkKind = argv[++i];
+    } else if (arg == "--iterative") {
+      iterative = true;
+    } else if (arg == "--threads" && i + 1 < argc) {
+      numThreads = std::stoi(argv[++i]);
+    } else if (arg == "--scaling" && i + 1 < argc) {
+      printParallelScaling(std::stoi(argv[++i]));
+      return 0;
+    } else if (arg == "--verify" && i + 1 < argc) {
+      return verifyGenerator(std::stoi(argv[++i])) ? 0 : 1;
+    } else {
+      nValues.push_back(std::stoi(arg));
+    }
+  }
+
+  if (nValues.empty()) {
+    nValues = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  }
 
   for (int n : nValues) {
-    HanoiGraphSolver solver(n, "hanoi_graph_solution_" 
-                                + std::to_string(n) + 
-                                "_disks.txt");
-    solver.solve();
+    if (numThreads > 0) {
+      solveParallel(n, numThreads, 
+                    "hanoi_graph_solution_" + std::to_string(n) + "_disks.txt");
+      continue;
+    }
+
+    std::unique_ptr<MoveSink> sink = makeSink(sinkKind, n);
+    long long moveCount;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    if (iterative) {
+      moveCount = solveIterative(n, *sink);
+    } else {
+      HanoiGraphSolver solver(n, *sink);
+      solver.solve();
+      moveCount = solver.getMoveCount();
+    }
+    sink.reset();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    if (sinkKind != "text") {
+      std::cout << "n = " << n << ", moves = " << moveCount 
+                << ", time = " 
+                << std::chrono::duration<double, std::milli>(end - start).count()
+                << " ms (" << sinkKind << " sink)" << std::endl;
+    }
   }
 
   return 0;
-}
\ No newline at end of file
+}
+
+// Bad arguments and write errors, in every mode, end in a message rather
+// than std::terminate
+int main(int argc, char* argv[]) {
+  try {
+    return run(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -1,10 +1,43 @@
 #include <iostream>
-#include <functional>
-#include <chrono>
 #include <vector>
 #include <iomanip>
-#include <random>
 #include <sstream>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "../../common/bench.h"
+#include "../../common/perf_counters.h"
+#include "../../common/rng.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Storage for n * n ints, aligned to 2 MiB once it is at least that large
+// so the kernel can back it with transparent huge pages
+int* allocateMatrixStorage(int n) {
+  const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+  size_t bytes = (size_t)n * n * sizeof(int);
+  size_t alignment = bytes >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : 64;
+  size_t rounded = (bytes + alignment - 1) / alignment * alignment;
+
+  void* p = std::aligned_alloc(alignment, std::max(rounded, alignment));
+  if (!p) throw std::bad_alloc();
+#ifdef __linux__
+  if (alignment == HUGE_PAGE_SIZE) madvise(p, rounded, MADV_HUGEPAGE);
+#endif
+  std::memset(p, 0, bytes);
+  return static_cast<int*>(p);
+}
 
 // n x n matrix represented as a contiguous block
 struct Matrix {
@@ -12,24 +45,36 @@ struct Matrix {
   int* data;
 
   Matrix(int n) : n(n) {
-    data = new int[n * n]();
+    data = allocateMatrixStorage(n);
   }
 
   ~Matrix() {
-    delete[] data;
+    std::free(data);
   }
 
   Matrix(const Matrix& other) : n(other.n) {
-    data = new int[n * n];
-    std::copy(other.data, other.data + n * n, data);
+    data = allocateMatrixStorage(n);
+    std::copy(other.data, other.data + (size_t)n * n, data);
+  }
+
+  Matrix(Matrix&& other) noexcept : n(other.n), data(other.data) {
+    other.n = 0;
+    other.data = nullptr;
   }
 
   Matrix& operator=(const Matrix& other) {
     if (this != &other) {
-      delete[] data;
-      n = other.n;
-      data = new int[n * n];
-      std::copy(other.data, other.data + n * n, data);
+      Matrix copy(other);
+      *this = std::move(copy);
+    }
+    return *this;
+  }
+
+  Matrix& operator=(Matrix&& other) noexcept {
+    if (this != &other) {
+      std::free(data);
+      n = std::exchange(other.n, 0);
+      data = std::exchange(other.data, nullptr);
     }
     return *this;
   }
@@ -37,118 +82,357 @@ struct Matrix {
 
 void fillWithRandomValues(Matrix& A) {
   int n = A.n;
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<int> dis(1, 100);
-  
-  for (int i = 0; i < n * n; i++) {
-    A.data[i] = dis(gen);
-  }
+  rng::Generator gen(rng::randomSeed());
+  gen.fillUniform(A.data, size_t(n) * n, 1, 100);
 }
 
 // Row-major matrix addition
-Matrix addRowMajor(const Matrix& A, const Matrix& B) {
+void addRowMajor(const Matrix& A, const Matrix& B, Matrix& C) {
   int n = A.n;
-  Matrix C(n);
   for (int i = 0; i < n; i++) {
     for (int j = 0; j < n; j++) {
       C.data[i * n + j] = A.data[i * n + j] + B.data[i * n + j];
     }
   }
-  return C;
 }
 
 // Column-major matrix addition
-Matrix addColumnMajor(const Matrix& A, const Matrix& B) {
+void addColumnMajor(const Matrix& A, const Matrix& B, Matrix& C) {
   int n = A.n;
-  Matrix C(n);
   for (int j = 0; j < n; j++) {
     for (int i = 0; i < n; i++) {
       C.data[i * n + j] = A.data[i * n + j] + B.data[i * n + j];
     }
   }
-  return C;
 }
 
-using addFunc = std::function<Matrix(const Matrix&, const Matrix&)>;
-using timePoint = std::chrono::high_resolution_clock::time_point;
+// Column-major order inside 64 x 64 tiles, so each tile's rows stay in
+// cache while its columns are walked
+const int TILE_SIZE = 64;
 
-double getAverageFunctionExecutionTime(addFunc f, int numberOfExecutions, const Matrix& A, const Matrix& B) {
-  double totalTime = 0.0;
+void addColumnMajorTiled(const Matrix& A, const Matrix& B, Matrix& C) {
+  int n = A.n;
+  for (int ib = 0; ib < n; ib += TILE_SIZE) {
+    for (int jb = 0; jb < n; jb += TILE_SIZE) {
+      int iEnd = std::min(ib + TILE_SIZE, n);
+      int jEnd = std::min(jb + TILE_SIZE, n);
+      for (int j = jb; j < jEnd; j++) {
+        for (int i = ib; i < iEnd; i++) {
+          C.data[i * n + j] = A.data[i * n + j] + B.data[i * n + j];
+        }
+      }
+    }
+  }
+}
 
-  for (int i = 0; i < 100; i++) {
-    Matrix warmup = f(A, B);
+// Column-major addition through tile buffers: each 64 x 64 tile of A and B
+// is copied in row by row, at unit stride, the column walk runs inside the
+// buffers, and the summed tile is copied out to C row by row
+void addColumnMajorBuffered(const Matrix& A, const Matrix& B, Matrix& C) {
+  int n = A.n;
+  static thread_local int tileA[TILE_SIZE][TILE_SIZE];
+  static thread_local int tileB[TILE_SIZE][TILE_SIZE];
+  for (int ib = 0; ib < n; ib += TILE_SIZE) {
+    for (int jb = 0; jb < n; jb += TILE_SIZE) {
+      int rows = std::min(TILE_SIZE, n - ib);
+      int cols = std::min(TILE_SIZE, n - jb);
+      for (int r = 0; r < rows; r++) {
+        std::memcpy(tileA[r], A.data + (size_t)(ib + r) * n + jb, cols * sizeof(int));
+        std::memcpy(tileB[r], B.data + (size_t)(ib + r) * n + jb, cols * sizeof(int));
+      }
+      for (int c = 0; c < cols; c++) {
+        for (int r = 0; r < rows; r++) {
+          tileA[r][c] += tileB[r][c];
+        }
+      }
+      for (int r = 0; r < rows; r++) {
+        std::memcpy(C.data + (size_t)(ib + r) * n + jb, tileA[r], cols * sizeof(int));
+      }
+    }
   }
+}
 
-  for (int i = 0; i < numberOfExecutions; i++) {
-    timePoint start = std::chrono::high_resolution_clock::now();
-    Matrix result = f(A, B);  
+// Row-major addition is one flat elementwise pass, so the vector kernels
+// work on ranges of the contiguous arrays
+using rangeKernel = void (*)(const int*, const int*, int*, size_t);
 
-    timePoint end = std::chrono::high_resolution_clock::now();
-    totalTime += std::chrono::duration<double, std::milli>(end - start).count();
+void addRangeScalar(const int* a, const int* b, int* c, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    c[i] = a[i] + b[i];
   }
+}
 
-  return totalTime / numberOfExecutions;
+#if defined(__GNUC__) && defined(__x86_64__)
+__attribute__((target("sse2")))
+void addRangeSSE2(const int* a, const int* b, int* c, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    _mm_storeu_si128((__m128i*)(c + i), _mm_add_epi32(va, vb));
+  }
+  addRangeScalar(a + i, b + i, c + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void addRangeAVX2(const int* a, const int* b, int* c, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+    _mm256_storeu_si256((__m256i*)(c + i), _mm256_add_epi32(va, vb));
+  }
+  addRangeScalar(a + i, b + i, c + i, count - i);
+}
+
+bool hasSSE2() { return __builtin_cpu_supports("sse2"); }
+bool hasAVX2() { return __builtin_cpu_supports("avx2"); }
+#else
+void addRangeSSE2(const int* a, const int* b, int* c, size_t count) {
+  addRangeScalar(a, b, c, count);
 }
 
-struct ScaledTime {
-  double value;
-  std::string unit;
+void addRangeAVX2(const int* a, const int* b, int* c, size_t count) {
+  addRangeScalar(a, b, c, count);
+}
+
+bool hasSSE2() { return false; }
+bool hasAVX2() { return false; }
+#endif
+
+bool alwaysSupported() { return true; }
+
+// Widest vector kernel the CPU supports, picked once from CPUID
+rangeKernel bestRangeKernel() {
+  static rangeKernel best = hasAVX2() ? addRangeAVX2 
+                          : hasSSE2() ? addRangeSSE2 
+                          : addRangeScalar;
+  return best;
+}
+
+void addRowMajorSSE2(const Matrix& A, const Matrix& B, Matrix& C) {
+  addRangeSSE2(A.data, B.data, C.data, (size_t)A.n * A.n);
+}
+
+void addRowMajorAVX2(const Matrix& A, const Matrix& B, Matrix& C) {
+  addRangeAVX2(A.data, B.data, C.data, (size_t)A.n * A.n);
+}
+
+// Splits the rows across hardware threads, each running the best vector kernel
+void addRowMajorThreaded(const Matrix& A, const Matrix& B, Matrix& C) {
+  int n = A.n;
+  int numThreads = std::max(1u, std::thread::hardware_concurrency());
+  int rowsPerThread = (n + numThreads - 1) / numThreads;
+  rangeKernel kernel = bestRangeKernel();
+  std::vector<std::thread> workers;
+
+  for (int t = 0; t < numThreads; t++) {
+    int rowBegin = t * rowsPerThread;
+    int rowEnd = std::min(n, rowBegin + rowsPerThread);
+    if (rowBegin >= rowEnd) break;
+    size_t offset = (size_t)rowBegin * n;
+    size_t count = (size_t)(rowEnd - rowBegin) * n;
+    workers.emplace_back(kernel, A.data + offset, B.data + offset, 
+                         C.data + offset, count);
+  }
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+// Column-major tiles split across threads by tile row
+void addColumnMajorTiledThreaded(const Matrix& A, const Matrix& B, Matrix& C) {
+  int n = A.n;
+  int numThreads = std::max(1u, std::thread::hardware_concurrency());
+  int numTileRows = (n + TILE_SIZE - 1) / TILE_SIZE;
+  std::vector<std::thread> workers;
+
+  for (int t = 0; t < numThreads; t++) {
+    workers.emplace_back([&, t]() {
+      for (int ib = t * TILE_SIZE; ib < n; ib += numThreads * TILE_SIZE) {
+        for (int jb = 0; jb < n; jb += TILE_SIZE) {
+          int iEnd = std::min(ib + TILE_SIZE, n);
+          int jEnd = std::min(jb + TILE_SIZE, n);
+          for (int j = jb; j < jEnd; j++) {
+            for (int i = ib; i < iEnd; i++) {
+              C.data[i * n + j] = A.data[i * n + j] + B.data[i * n + j];
+            }
+          }
+        }
+      }
+    });
+    if (t + 1 >= numTileRows) break;
+  }
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+// Kernels write into a preallocated C, so timing covers only the addition
+using addFunc = void (*)(const Matrix&, const Matrix&, Matrix&);
+
+std::vector<bench::Result> benchResults;
+
+// Median milliseconds per call, with at least numberOfExecutions samples
+double getMedianFunctionExecutionTime(const std::string& name, addFunc f, 
+                                      int numberOfExecutions, const Matrix& A, 
+                                      const Matrix& B, Matrix& C) {
+  bench::Options opts;
+  opts.minSamples = numberOfExecutions;
+  bench::Result result = bench::run(name, [&]() {
+    f(A, B, C);
+    bench::clobberMemory();
+  }, opts);
+
+  benchResults.push_back(result);
+  return result.median * 1000.0;
+}
+
+// Cost the old by-value kernels paid on every call: allocating and zeroing
+// a fresh result matrix, including its page faults, then freeing it
+double getMedianAllocationTime(int n, int numberOfExecutions) {
+  bench::Options opts;
+  opts.minSamples = numberOfExecutions;
+  bench::Result result = bench::run("alloc/n=" + std::to_string(n), [&]() {
+    Matrix C(n);
+    bench::doNotOptimize(C.data);
+  }, opts);
+
+  benchResults.push_back(result);
+  return result.median * 1000.0;
+}
+
+// Hardware counters per call, over as many calls as one timing sample made
+perf::Sample getKernelCounters(addFunc f, long long calls, 
+                               const Matrix& A, const Matrix& B, Matrix& C) {
+  perf::Counters counters;
+  counters.start();
+  for (long long i = 0; i < calls; i++) {
+    f(A, B, C);
+    bench::clobberMemory();
+  }
+  return counters.stop().per(calls);
+}
+
+struct AdditionKernel {
+  std::string name;
+  addFunc func;
+  bool (*supported)();
 };
 
-ScaledTime scaleTime(double ms) {
-  ScaledTime t;
-  if (ms < 1000.0) {
-    t.value = ms;
-    t.unit = "ms";
-  } else if (ms < 60000.0) {
-    t.value = ms / 1000.0;
-    t.unit = "s";
-  } else if (ms < 3600000.0) {
-    t.value = ms / 60000.0;
-    t.unit = "min";
-  } else {
-    t.value = ms / 3600000.0;
-    t.unit = "h";
+// Every addition kernel, reported side by side
+const std::vector<AdditionKernel>& getAdditionKernels() {
+  static const std::vector<AdditionKernel> kernels = {
+    {"Row-major", addRowMajor, alwaysSupported},
+    {"Row SSE2", addRowMajorSSE2, hasSSE2},
+    {"Row AVX2", addRowMajorAVX2, hasAVX2},
+    {"Row threaded", addRowMajorThreaded, alwaysSupported},
+    {"Column-major", addColumnMajor, alwaysSupported},
+    {"Col tiled", addColumnMajorTiled, alwaysSupported},
+    {"Col buffered", addColumnMajorBuffered, alwaysSupported},
+    {"Col tiled thr.", addColumnMajorTiledThreaded, alwaysSupported},
+  };
+  return kernels;
+}
+
+// Each addition reads A and B and writes C
+double toGigabytesPerSecond(int n, double ms) {
+  double bytes = 3.0 * n * n * sizeof(int);
+  return bytes / (ms / 1000.0) / 1e9;
+}
+
+void printTableRow(const std::string& first, const std::vector<std::string>& cells) {
+  std::cout << std::setw(10) << std::right << first;
+  for (const std::string& cell : cells) {
+    std::cout << " | " << std::setw(14) << std::right << cell;
   }
-  return t;
+  std::cout << std::endl;
 }
 
+std::string formatCell(double value, int precision) {
+  if (value < 0) return "n/a";
+  std::ostringstream cell;
+  cell << std::fixed << std::setprecision(precision) << value;
+  return cell.str();
+}
 
+// Median kernel times exclude allocation, which is reported in its own column.
+// Every kernel's time and per-call hardware counters also go to 
+// matrix_addition_results.csv.
 void printMatrixAdditionTimings(std::vector<int> nValues, int numberOfExecutions) {
-  std::cout << "Matrix Addition Timings\n";
-  std::cout << "--------------------------------------------------------\n";
-  std::cout << std::setw(10) << std::right << "n" << " | "
-            << std::setw(20) << std::right << "Row-major" << " | "
-            << std::setw(20) << std::right << "Column-major" << std::endl;
-  std::cout << "--------------------------------------------------------\n";
+  const std::vector<AdditionKernel>& kernels = getAdditionKernels();
+  std::vector<double> allocationTimes;
+  std::vector<std::vector<double>> kernelTimes;
+
+  std::ofstream csv("matrix_addition_results.csv");
+  csv << "n,Kernel,Median_ms,GB_per_s," << perf::csvHeader("") << "\n";
 
   for (int i = 0; i < nValues.size(); i++) {
     int n = nValues[i];
-    Matrix A(n), B(n);
+    // Before A, B and C exist, so the timed matrix is the only one alive
+    // and peak memory stays at three matrices
+    allocationTimes.push_back(getMedianAllocationTime(n, numberOfExecutions));
+
+    Matrix A(n), B(n), C(n);
     fillWithRandomValues(A);
     fillWithRandomValues(B);
-    
-    double rowTime = 
-      getAverageFunctionExecutionTime(addRowMajor, numberOfExecutions, A, B);
-    double colTime = 
-      getAverageFunctionExecutionTime(addColumnMajor, numberOfExecutions, A, B);
-    
-    ScaledTime scaledRowTime = scaleTime(rowTime);
-    ScaledTime scaledColTime = scaleTime(colTime);
-    
-    std::ostringstream rowStr, colStr;
-    rowStr << std::fixed << std::setprecision(6) 
-           << scaledRowTime.value << " " << scaledRowTime.unit;
-    colStr << std::fixed << std::setprecision(6) 
-           << scaledColTime.value << " " << scaledColTime.unit;
-    
-    std::cout << std::setw(10) << std::right << n << " | "
-              << std::setw(20) << std::right << rowStr.str() << " | "
-              << std::setw(20) << std::right << colStr.str() << std::endl;
+    kernelTimes.emplace_back();
+    for (const AdditionKernel& kernel : kernels) {
+      if (!kernel.supported()) {
+        kernelTimes.back().push_back(-1.0);
+        continue;
+      }
+
+      std::string name = kernel.name + "/n=" + std::to_string(n);
+      double ms = 
+        getMedianFunctionExecutionTime(name, kernel.func, numberOfExecutions, A, B, C);
+      perf::Sample counters = 
+        getKernelCounters(kernel.func, benchResults.back().iterations, A, B, C);
+      kernelTimes.back().push_back(ms);
+
+      csv << n << "," << kernel.name << "," << ms << "," 
+          << toGigabytesPerSecond(n, ms) << "," << perf::csvValues(counters) << "\n";
+      csv.flush();
+    }
+  }
+
+  std::vector<std::string> names;
+  for (const AdditionKernel& kernel : kernels) {
+    names.push_back(kernel.name);
+  }
+
+  std::vector<std::string> timeHeader = {"Alloc"};
+  timeHeader.insert(timeHeader.end(), names.begin(), names.end());
+  std::string rule(10 + timeHeader.size() * 17, '-');
+
+  std::cout << "Matrix Addition Median Time (ms)\n";
+  std::cout << rule << "\n";
+  printTableRow("n", timeHeader);
+  std::cout << rule << "\n";
+  for (size_t i = 0; i < nValues.size(); i++) {
+    std::vector<std::string> cells = {formatCell(allocationTimes[i], 4)};
+    for (double ms : kernelTimes[i]) {
+      cells.push_back(formatCell(ms, 4));
+    }
+    printTableRow(std::to_string(nValues[i]), cells);
   }
+  std::cout << rule << "\n\n";
 
-  std::cout << "--------------------------------------------------------\n\n";
+  rule = std::string(10 + names.size() * 17, '-');
+  std::cout << "Matrix Addition Throughput (GB/s)\n";
+  std::cout << rule << "\n";
+  printTableRow("n", names);
+  std::cout << rule << "\n";
+  for (size_t i = 0; i < nValues.size(); i++) {
+    std::vector<std::string> cells;
+    for (double ms : kernelTimes[i]) {
+      cells.push_back(formatCell(ms < 0 ? -1.0 : toGigabytesPerSecond(nValues[i], ms), 2));
+    }
+    printTableRow(std::to_string(nValues[i]), cells);
+  }
+  std::cout << rule << "\n\n";
 }
 
 int main() {
@@ -160,8 +444,9 @@ int main() {
         std::cout << nValues[i];
         if (i < nValues.size() - 1) std::cout << ", ";
     }
-    std::cout << "\nExecutions per test: " << numberOfExecutions << "\n\n";
+    std::cout << "\nMinimum samples per test: " << numberOfExecutions << "\n\n";
     
     printMatrixAdditionTimings(nValues, numberOfExecutions);
+    bench::writeReports(benchResults);
     return 0;
 }
@@ -1,47 +1,219 @@
 #include <iostream>
+#include <iomanip>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 #include <vector>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "../../common/bench.h"
+
+extern char** environ;
+
+// The pipe each test writes its "name,size,seconds" result lines to
+const int RESULTS_FD = 3;
+
+struct TestProgram {
+  std::string label;
+  std::vector<std::string> argv;
+};
+
+struct TestRun {
+  bool ok = false;
+  double wallSeconds = 0;
+  rusage usage{};
+  // "<label> <name>" -> array size -> seconds for 30,000,000 searches
+  std::map<std::string, std::map<int, double>> results;
+};
+
+// Starts program with posix_spawnp, so there is no shell in between, hands
+// it the write end of a pipe as RESULTS_FD and collects what it writes there
+// along with its exit status and resource usage. stdout and stderr pass
+// through.
+TestRun runTest(const TestProgram& program, int executions) {
+  TestRun run;
+
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) != 0) {
+    std::cerr << "pipe: " << std::strerror(errno) << std::endl;
+    return run;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], RESULTS_FD);
+
+  std::vector<std::string> args = program.argv;
+  args.push_back(std::to_string(executions));
+  std::vector<char*> argv;
+  for (std::string& arg : args) argv.push_back(arg.data());
+  argv.push_back(nullptr);
+
+  std::vector<std::string> env = {"BENCH_RESULTS_FD=" + std::to_string(RESULTS_FD)};
+  for (char** e = environ; *e; e++) {
+    if (std::strncmp(*e, "BENCH_RESULTS_FD=", 17) != 0) env.push_back(*e);
+  }
+  std::vector<char*> envp;
+  for (std::string& e : env) envp.push_back(e.data());
+  envp.push_back(nullptr);
+
+  bench::Clock::time_point start = bench::Clock::now();
+  pid_t pid;
+  int error = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), envp.data());
+  posix_spawn_file_actions_destroy(&actions);
+  close(fds[1]);
+  if (error != 0) {
+    std::cerr << "Could not start " << argv[0] << ": " << std::strerror(error) << std::endl;
+    close(fds[0]);
+    return run;
+  }
+
+  // Read until the child exits and the pipe closes
+  std::string output;
+  char buffer[4096];
+  ssize_t bytes;
+  while ((bytes = read(fds[0], buffer, sizeof(buffer))) != 0) {
+    if (bytes < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    output.append(buffer, bytes);
+  }
+  close(fds[0]);
+
+  int status;
+  while (wait4(pid, &status, 0, &run.usage) < 0 && errno == EINTR) {}
+  run.wallSeconds = bench::secondsSince(start);
+  run.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+  std::istringstream lines(output);
+  std::string line;
+  while (std::getline(lines, line)) {
+    std::istringstream fields(line);
+    std::string name, size, seconds;
+    if (std::getline(fields, name, ',') && std::getline(fields, size, ',') &&
+        std::getline(fields, seconds)) {
+      run.results[program.label + " " + name][std::stoi(size)] = std::stod(seconds);
+    }
+  }
+  return run;
+}
+
+double toSeconds(const timeval& t) {
+  return t.tv_sec + t.tv_usec / 1e6;
+}
+
+void printComparison(const std::vector<TestProgram>& programs,
+                     const std::vector<TestRun>& runs) {
+  std::vector<std::string> columns;
+  std::set<int> sizes;
+  for (const TestRun& run : runs) {
+    for (const auto& [column, bySize] : run.results) {
+      columns.push_back(column);
+      for (const auto& entry : bySize) sizes.insert(entry.first);
+    }
+  }
+
+  std::cout << "Seconds for 30,000,000 Unsuccessful Searches" << std::endl;
+  std::cout << std::setw(10) << std::right << "Size";
+  for (const std::string& column : columns) {
+    std::cout << " | " << std::setw(22) << std::right << column;
+  }
+  std::cout << std::endl;
+  for (int size : sizes) {
+    std::cout << std::setw(10) << std::right << size;
+    for (const std::string& column : columns) {
+      std::cout << " | " << std::setw(22) << std::right;
+      for (const TestRun& run : runs) {
+        auto it = run.results.find(column);
+        if (it == run.results.end()) continue;
+        auto cell = it->second.find(size);
+        if (cell == it->second.end()) {
+          std::cout << "-";
+        } else {
+          std::cout << std::fixed << std::setprecision(3) << cell->second;
+        }
+      }
+    }
+    std::cout << std::endl;
+  }
+
+  std::cout << std::endl << "Per-process resource usage" << std::endl;
+  std::cout << std::setw(16) << std::left << "Test"
+            << " | " << std::setw(6) << std::right << "Status"
+            << " | " << std::setw(10) << std::right << "Wall (s)"
+            << " | " << std::setw(10) << std::right << "User (s)"
+            << " | " << std::setw(10) << std::right << "Sys (s)"
+            << " | " << std::setw(12) << std::right << "Max RSS (MB)"
+            << " | " << std::setw(10) << std::right << "Vol CS"
+            << " | " << std::setw(10) << std::right << "Invol CS" << std::endl;
+  for (size_t i = 0; i < runs.size(); i++) {
+    const TestRun& run = runs[i];
+    std::cout << std::setw(16) << std::left << programs[i].label
+              << " | " << std::setw(6) << std::right << (run.ok ? "ok" : "failed")
+              << std::fixed << std::setprecision(3)
+              << " | " << std::setw(10) << std::right << run.wallSeconds
+              << " | " << std::setw(10) << std::right << toSeconds(run.usage.ru_utime)
+              << " | " << std::setw(10) << std::right << toSeconds(run.usage.ru_stime)
+              << std::setprecision(1)
+              << " | " << std::setw(12) << std::right << run.usage.ru_maxrss / 1024.0
+              << " | " << std::setw(10) << std::right << run.usage.ru_nvcsw
+              << " | " << std::setw(10) << std::right << run.usage.ru_nivcsw << std::endl;
+  }
+}
 
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " <executions>" << std::endl;
+  if (argc != 2 && !(argc == 4 && std::string(argv[2]) == "--cpu")) {
+    std::cerr << "Usage: " << argv[0] << " <executions> [--cpu N]" << std::endl;
     return 1;
   }
 
-  int executions;
+  int executions, cpu = -1;
   try {
     executions = std::stoi(argv[1]);
     if (executions <= 0) throw std::invalid_argument("Non-positive number");
+    if (argc == 4) cpu = std::stoi(argv[3]);
   } catch (const std::exception&) {
     std::cerr << "Invalid arguments." << std::endl;
     return 1;
   }
 
-  std::cout << "\nRunning Binary Search Performance Tests" << std::endl;
-  std::cout << "Executions per test: " << executions << std::endl << std::endl;
+  // Spawned processes inherit the runner's affinity, so pinning the runner
+  // pins every test to the same core from its first instruction. That
+  // includes every thread of the C++ batch tests, so it is opt-in.
+  bench::CpuPin pin(cpu);
 
-  std::vector<std::string> commands = {
-    ".\\tests\\test.exe " + std::to_string(executions),           
-    "python tests\\test.py " + std::to_string(executions),
-    "node tests\\test.js " + std::to_string(executions)
-  };
+  std::cout << "\nRunning Binary Search Performance Tests" << std::endl;
+  std::cout << "Executions per test: " << executions << ", "
+            << (cpu >= 0 ? "pinned to CPU " + std::to_string(cpu) : std::string("unpinned"))
+            << std::endl << std::endl;
 
-  std::vector<std::string> test_names = {
-    "C++ Test",
-    "Python Test", 
-    "TypeScript Test"
+  std::vector<TestProgram> programs = {
+    {"C++", {"./tests/test"}},
+    {"Python", {"python3", "tests/test.py"}},
+    {"TypeScript", {"node", "tests/test.js"}}
   };
 
-  for (size_t i = 0; i < commands.size(); i++) {
-    std::cout << "Running " << test_names[i] << "..." << std::endl;
-    int result = std::system(commands[i].c_str());
-    if (result != 0) {
-      std::cerr << test_names[i] << " failed with exit code " << result << std::endl;
-      return 1;
+  std::vector<TestRun> runs;
+  bool allOk = true;
+  for (const TestProgram& program : programs) {
+    std::cout << "Running " << program.label << " Test..." << std::endl;
+    runs.push_back(runTest(program, executions));
+    if (!runs.back().ok) {
+      std::cerr << program.label << " Test failed" << std::endl;
+      allOk = false;
     }
     std::cout << std::endl;
   }
 
-  return 0;
-}
\ No newline at end of file
+  printComparison(programs, runs);
+  return allOk ? 0 : 1;
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdlib>
+#include <climits>
+#include <bit>
+#include <algorithm>
+#include <span>
+#include <thread>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Search structures over a sorted std::vector<int>. Like binarySearch,
+// every find() returns the index of target in the sorted array, or -1.
+// findBatch() does the same for a span of queries, searching batchWidth
+// of them in lockstep so their cache misses overlap instead of queueing.
+
+constexpr int batchWidth = 16;
+
+// Branchless lower_bound: the loop length depends only on the array size,
+// and both possible next midpoints are prefetched one step ahead
+class BranchlessSearch {
+public:
+  BranchlessSearch(const std::vector<int>& array) : array(array) {}
+
+  int find(int target) const {
+    int n = array.size();
+    if (n == 0) return -1;
+
+    const int* base = array.data();
+    int len = n;
+    while (len > 1) {
+      int half = len / 2;
+      len -= half;
+      __builtin_prefetch(&base[len / 2 - 1]);
+      __builtin_prefetch(&base[half + len / 2 - 1]);
+      base += (base[half - 1] < target) * half;
+    }
+
+    int index = base - array.data() + (*base < target);
+    return index < n && array[index] == target ? index : -1;
+  }
+
+  void findBatch(std::span<const int> queries, std::span<int> results) const {
+    int n = array.size();
+    for (size_t i = 0; i < queries.size(); i += batchWidth) {
+      int m = std::min<size_t>(batchWidth, queries.size() - i);
+      const int* q = queries.data() + i;
+      if (n == 0) {
+        std::fill_n(results.data() + i, m, -1);
+        continue;
+      }
+
+      // The loop length depends only on n, so every query takes the
+      // same number of steps
+      const int* base[batchWidth];
+      std::fill_n(base, m, array.data());
+      int len = n;
+      while (len > 1) {
+        int half = len / 2;
+        len -= half;
+        for (int j = 0; j < m; j++) {
+          __builtin_prefetch(&base[j][len / 2 - 1]);
+          __builtin_prefetch(&base[j][half + len / 2 - 1]);
+          base[j] += (base[j][half - 1] < q[j]) * half;
+        }
+      }
+
+      for (int j = 0; j < m; j++) {
+        int index = base[j] - array.data() + (*base[j] < q[j]);
+        results[i + j] = index < n && array[index] == q[j] ? index : -1;
+      }
+    }
+  }
+
+private:
+  const std::vector<int>& array;
+};
+
+// Eytzinger (BFS-order) layout: node k has children 2k and 2k + 1, so the
+// first levels share cache lines and the 16 descendants four levels down
+// sit in one line that can be prefetched
+class EytzingerSearch {
+public:
+  EytzingerSearch(const std::vector<int>& array)
+    : n(array.size()), tree(n + 1), sortedIndex(n + 1) {
+    build(array, 0, 1);
+  }
+
+  int find(int target) const {
+    int k = 1;
+    while (k <= n) {
+      __builtin_prefetch(tree.data() + (size_t)k * 16);
+      k = 2 * k + (tree[k] < target);
+    }
+    // Undo the right turns taken after the last left turn
+    k >>= std::countr_one((unsigned)k) + 1;
+    return k != 0 && tree[k] == target ? sortedIndex[k] : -1;
+  }
+
+  void findBatch(std::span<const int> queries, std::span<int> results) const {
+    // Leaves sit at depth bit_width(n) - 1 or one above, so that many
+    // steps take every query past the bottom; finished ones stay put
+    int depth = std::bit_width((unsigned)n);
+    for (size_t i = 0; i < queries.size(); i += batchWidth) {
+      int m = std::min<size_t>(batchWidth, queries.size() - i);
+      const int* q = queries.data() + i;
+
+      int k[batchWidth];
+      std::fill_n(k, m, 1);
+      for (int level = 0; level < depth; level++) {
+        for (int j = 0; j < m; j++) {
+          __builtin_prefetch(tree.data() + (size_t)k[j] * 16);
+          k[j] = k[j] <= n ? 2 * k[j] + (tree[k[j]] < q[j]) : k[j];
+        }
+      }
+
+      for (int j = 0; j < m; j++) {
+        int node = k[j] >> (std::countr_one((unsigned)k[j]) + 1);
+        results[i + j] = node != 0 && tree[node] == q[j] ? sortedIndex[node] : -1;
+      }
+    }
+  }
+
+private:
+  // In-order walk of the implicit tree, filling it from the sorted array
+  int build(const std::vector<int>& array, int i, int k) {
+    if (k <= n) {
+      i = build(array, i, 2 * k);
+      tree[k] = array[i];
+      sortedIndex[k] = i++;
+      i = build(array, i, 2 * k + 1);
+    }
+    return i;
+  }
+
+  int n;
+  std::vector<int> tree;
+  std::vector<int> sortedIndex;
+};
+
+// Static B+ tree (S+ tree) with 16-key, cache-line-sized nodes. Layer 0 is
+// the sorted array itself, padded with INT_MAX; each layer above holds the
+// smallest key of every subtree to the right of a node's keys. Search does
+// one SIMD rank per layer and no data-dependent branches, and ends at the
+// lower bound's index in the sorted array.
+class STreeSearch {
+public:
+  static constexpr int B = 16;
+
+  STreeSearch(const std::vector<int>& array) : n(array.size()) {
+    height = layerHeight(n);
+    for (int h = 0; h <= height; h++) offsets[h] = layerOffset(h);
+    size = std::max(offsets[height], B);
+    tree.reset(static_cast<int*>(std::aligned_alloc(64, size * sizeof(int))));
+
+    for (int i = 0; i < n; i++) tree[i] = array[i];
+    for (int i = n; i < size; i++) tree[i] = INT_MAX;
+
+    for (int h = 1; h < height; h++) {
+      int layerStart = offsets[h];
+      int layerSize = offsets[h + 1] - layerStart;
+      for (int i = 0; i < layerSize; i++) {
+        // Smallest key of the subtree right of key i: go right once, then
+        // always left down to layer 0
+        int k = i / B, j = i % B;
+        long long node = (long long)k * (B + 1) + j + 1;
+        for (int l = 1; l < h; l++) node *= (B + 1);
+        tree[layerStart + i] = node * B < n ? tree[node * B] : INT_MAX;
+      }
+    }
+
+    rank = hasAVX2() ? rankAVX2 : rankScalar;
+  }
+
+  int find(int target) const {
+    int k = 0;
+    for (int h = height - 1; h > 0; h--) {
+      int i = rank(target, tree.get() + offsets[h] + k);
+      k = k * (B + 1) + i * B;
+    }
+    int index = k + rank(target, tree.get() + k);
+    return index < n && tree[index] == target ? index : -1;
+  }
+
+  void findBatch(std::span<const int> queries, std::span<int> results) const {
+    for (size_t i = 0; i < queries.size(); i += batchWidth) {
+      int m = std::min<size_t>(batchWidth, queries.size() - i);
+      const int* q = queries.data() + i;
+
+      int k[batchWidth] = {};
+      for (int h = height - 1; h > 0; h--) {
+        const int* layer = tree.get() + offsets[h];
+        for (int j = 0; j < m; j++) {
+          k[j] = k[j] * (B + 1) + rank(q[j], layer + k[j]) * B;
+          // Pull in the child node before the next layer needs it
+          __builtin_prefetch(tree.get() + offsets[h - 1] + k[j]);
+        }
+      }
+
+      for (int j = 0; j < m; j++) {
+        int index = k[j] + rank(q[j], tree.get() + k[j]);
+        results[i + j] = index < n && tree[index] == q[j] ? index : -1;
+      }
+    }
+  }
+
+private:
+  struct FreeDeleter {
+    void operator()(int* p) const { std::free(p); }
+  };
+
+  static int blocks(int keys) { return (keys + B - 1) / B; }
+
+  // Keys in the layer above one holding `keys` keys
+  static int keysAbove(int keys) { return (blocks(keys) + B) / (B + 1) * B; }
+
+  static int layerHeight(int keys) { return keys <= B ? 1 : layerHeight(keysAbove(keys)) + 1; }
+
+  // Start of layer h, in ints
+  int layerOffset(int h) const {
+    int offset = 0, keys = n;
+    while (h--) {
+      offset += blocks(keys) * B;
+      keys = keysAbove(keys);
+    }
+    return offset;
+  }
+
+  // Number of keys in a node smaller than target
+  static int rankScalar(int target, const int* node) {
+    int count = 0;
+    for (int i = 0; i < B; i++) count += node[i] < target;
+    return count;
+  }
+
+#if defined(__GNUC__) && defined(__x86_64__)
+  __attribute__((target("avx2")))
+  static int rankAVX2(int target, const int* node) {
+    __m256i x = _mm256_set1_epi32(target);
+    __m256i lo = _mm256_cmpgt_epi32(x, _mm256_load_si256((const __m256i*)node));
+    __m256i hi = _mm256_cmpgt_epi32(x, _mm256_load_si256((const __m256i*)(node + 8)));
+    unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(lo))
+                  | _mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8;
+    return std::popcount(mask);
+  }
+
+  static bool hasAVX2() { return __builtin_cpu_supports("avx2"); }
+#else
+  static int rankAVX2(int target, const int* node) { return rankScalar(target, node); }
+  static bool hasAVX2() { return false; }
+#endif
+
+  static constexpr int maxHeight = 8;  // 17^7 * 16 keys fit any int size
+
+  int n;
+  int height;
+  int size;
+  int offsets[maxHeight + 1];
+  std::unique_ptr<int[], FreeDeleter> tree;
+  int (*rank)(int, const int*);
+};
+
+// Interpolation search: probes where target would sit if the keys were
+// evenly spread, which takes O(log log n) probes on uniform keys
+class InterpolationSearch {
+public:
+  InterpolationSearch(const std::vector<int>& array) : array(array) {}
+
+  int find(int target) const {
+    int lo = 0, hi = (int)array.size() - 1;
+    while (lo <= hi && target >= array[lo] && target <= array[hi]) {
+      if (array[hi] == array[lo]) return lo;
+      // Widened before subtracting, as keys may span the whole int range
+      int pos = lo + ((long long)target - array[lo]) * (hi - lo)
+                     / ((long long)array[hi] - array[lo]);
+      if (array[pos] == target) return pos;
+      if (array[pos] < target) {
+        lo = pos + 1;
+      } else {
+        hi = pos - 1;
+      }
+    }
+    return -1;
+  }
+
+  // Probe counts differ per query, so there is no lockstep to exploit
+  void findBatch(std::span<const int> queries, std::span<int> results) const {
+    for (size_t i = 0; i < queries.size(); i++) {
+      results[i] = find(queries[i]);
+    }
+  }
+
+private:
+  const std::vector<int>& array;
+};
+
+// Runs search.findBatch over queries, split into contiguous chunks across
+// numThreads threads
+template <typename Search>
+void searchBatch(const Search& search, std::span<const int> queries,
+                 std::span<int> results, int numThreads = 1) {
+  if (numThreads <= 1) {
+    search.findBatch(queries, results);
+    return;
+  }
+
+  std::vector<std::thread> workers;
+  size_t chunk = (queries.size() + numThreads - 1) / numThreads;
+  for (int t = 0; t < numThreads; t++) {
+    size_t begin = std::min(queries.size(), t * chunk);
+    size_t end = std::min(queries.size(), begin + chunk);
+    workers.emplace_back([&, begin, end]() {
+      search.findBatch(queries.subspan(begin, end - begin),
+                       results.subspan(begin, end - begin));
+    });
+  }
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
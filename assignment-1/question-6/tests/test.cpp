@@ -1,8 +1,17 @@
 #include <iostream>
-#include <functional>
-#include <chrono>
 #include <vector>
 #include <iomanip>
+#include <string>
+#include <random>
+#include <cmath>
+#include <thread>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../../../common/bench.h"
+#include "search.h"
 
 int binarySearch(const std::vector<int>& array, int target) {
   int left = 0;
@@ -31,56 +40,256 @@ std::vector<int> createBinarySearchableArray(int size) {
   return array;
 }
 
-using searchFunction = std::function<int(std::vector<int>&, int)>;
-using timePoint = std::chrono::high_resolution_clock::time_point;
+// Wraps binarySearch in the find() interface of the structures in search.h
+class BinarySearch {
+public:
+  BinarySearch(const std::vector<int>& array) : array(array) {}
 
-double getAverageExecutionTime(searchFunction func, std::vector<int>& array, int target, int executions) {
-  int index = -1;
-  double totalTime = 0.0;
+  int find(int target) const { return binarySearch(array, target); }
 
-  // Warmup
-  for (int i = 0; i < std::max(10000, executions); i++) {
-    index = func(array, target);
+  void findBatch(std::span<const int> queries, std::span<int> results) const {
+    for (size_t i = 0; i < queries.size(); i++) {
+      results[i] = binarySearch(array, queries[i]);
+    }
   }
-  
-  for (int i = 0; i < executions; i++) {
-    timePoint start = std::chrono::high_resolution_clock::now();
 
-    for (int j = 0; j < 30000000; j++) {
-      index = func(array, target);
-    }
+private:
+  const std::vector<int>& array;
+};
+
+std::vector<bench::Result> benchResults;
+
+const int SEARCHES_PER_EXECUTION = 30000000;
+
+// Median seconds for 30,000,000 searches, from at least `executions` samples
+template <typename Search>
+double getMedianExecutionTime(const std::string& name, const Search& search,
+                              int target, int executions) {
+  bench::Options opts;
+  opts.minSamples = executions;
+  bench::Result result = bench::run(name, [&]() {
+    bench::doNotOptimize(search.find(target));
+  }, opts);
+
+  benchResults.push_back(result);
+  return result.median * SEARCHES_PER_EXECUTION;
+}
+
+// When started by runTests, every 30,000,000-search time is also written
+// as a "name,size,seconds" line to the pipe it passes in BENCH_RESULTS_FD
+void reportResult(const std::string& name, int size, double seconds) {
+  static FILE* pipe = []() -> FILE* {
+    const char* fd = std::getenv("BENCH_RESULTS_FD");
+    return fd ? fdopen(std::atoi(fd), "w") : nullptr;
+  }();
+  if (!pipe) return;
+  std::fprintf(pipe, "%s,%d,%.6f\n", name.c_str(), size, seconds);
+  std::fflush(pipe);
+}
+
+// Checks search against binarySearch on the ends, the middle and a miss
+template <typename Search>
+bool agreesWithBinarySearch(const Search& search, const std::vector<int>& array) {
+  int size = array.size();
+  for (int target : {0, size / 2, size - 1, size + 1, -1}) {
+    if (search.find(target) != binarySearch(array, target)) return false;
+  }
+  return true;
+}
 
-    timePoint end = std::chrono::high_resolution_clock::now();
-    totalTime += std::chrono::duration<double, std::nano>(end - start).count();
+// Checks search against binarySearch on keys spread from INT_MIN to
+// INT_MAX, where differences between keys overflow int: every key, and a
+// miss either side of each
+template <typename Search>
+bool agreesOnFullRangeKeys(const std::string& name) {
+  const int size = 1000;
+  std::vector<int> array(size);
+  for (int i = 0; i < size; i++) {
+    array[i] = (int)(INT_MIN + (long long)i * ((long long)INT_MAX - INT_MIN) / (size - 1));
+  }
+  Search search(array);
+  for (int key : array) {
+    for (long long target : {(long long)key - 1, (long long)key, (long long)key + 1}) {
+      if (target < INT_MIN || target > INT_MAX) continue;
+      if (search.find((int)target) != binarySearch(array, (int)target)) {
+        std::cerr << name << " disagrees with binarySearch on full-range keys" << std::endl;
+        return false;
+      }
+    }
   }
+  return true;
+}
 
-  return totalTime / executions / 1000000000; // Convert to seconds
+// Builds one search structure at a time, so only the array and a single
+// structure are in memory even at 2^28 elements
+template <typename Search>
+bool timeVariant(const std::string& name, const std::vector<int>& array,
+                 int target, int executions, double& medianExecutionTime) {
+  Search search(array);
+  if (!agreesWithBinarySearch(search, array)) {
+    std::cerr << name << " disagrees with binarySearch at size " << array.size() << std::endl;
+    return false;
+  }
+  medianExecutionTime = getMedianExecutionTime(
+    name + "/size=" + std::to_string(array.size()), search, target, executions);
+  reportResult(name, array.size(), medianExecutionTime);
+  return true;
 }
 
-void runTests(int executions) {
-  std::vector<int> arraySizes = {100, 400, 1600, 6400, 25600, 102400, 409600, 1638400};
+const std::vector<int> arraySizes = {100, 400, 1600, 6400, 25600, 102400, 409600, 1638400,
+                                     6553600, 26214400, 104857600, 268435456};
+
+bool runTests(int executions) {
+  const char* variants[] = {"binary", "branchless", "eytzinger", "stree", "interpolation"};
+
+  std::cout << "Median Execution Time for 30,000,000 Unsuccessful Searches (s)" << std::endl;
+  std::cout << std::setw(10) << std::right << "Size";
+  for (const char* variant : variants) {
+    std::cout << " | " << std::setw(13) << std::right << variant;
+  }
+  std::cout << std::endl;
 
   for (int i = 0; i < arraySizes.size(); i++) {
     int size = arraySizes[i];
     std::vector<int> array = createBinarySearchableArray(size);
     int target = size + 1; // Element not in array
 
-    double averageExecutionTime = getAverageExecutionTime(
-      binarySearch,
-      array,
-      target,
-      executions
-    );
-
-    std::cout << "Array Size: " << size 
-              << ", Average Execution Time for 30,000,000 Unsuccessful Searches: " 
-              << std::fixed << std::setprecision(3) << averageExecutionTime << " (s)" 
-              << std::endl;
+    double times[5];
+    bool ok = timeVariant<BinarySearch>("binarySearch", array, target, executions, times[0]) &&
+              timeVariant<BranchlessSearch>("branchless", array, target, executions, times[1]) &&
+              timeVariant<EytzingerSearch>("eytzinger", array, target, executions, times[2]) &&
+              timeVariant<STreeSearch>("stree", array, target, executions, times[3]) &&
+              timeVariant<InterpolationSearch>("interpolation", array, target, executions, times[4]);
+    if (!ok) return false;
+
+    std::cout << std::setw(10) << std::right << size;
+    for (double time : times) {
+      std::cout << " | " << std::setw(13) << std::right << std::fixed
+                << std::setprecision(3) << time;
+    }
+    std::cout << std::endl;
+  }
+  return true;
+}
+
+const int QUERIES_PER_BATCH = 1 << 20;
+
+enum QueryStream { Random, Zipfian, Sorted, NumStreams };
+const char* streamNames[NumStreams] = {"random", "zipfian", "sorted"};
+
+// Query keys over [0, 2 * size), so about half the searches miss:
+//  - random: uniform keys
+//  - zipfian: key ranks drawn with P(rank r) ~ 1 / r (by inverting the
+//    continuous CDF), scattered over the key range so hot keys are not
+//    neighbours
+//  - sorted: uniform keys in ascending order
+std::vector<int> createQueries(QueryStream stream, int size, std::mt19937& rng) {
+  long long range = 2LL * size;
+  std::vector<int> queries(QUERIES_PER_BATCH);
+  std::uniform_int_distribution<long long> uniform(0, range - 1);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+  for (int& query : queries) {
+    if (stream == Zipfian) {
+      long long rank = (long long)std::exp(unit(rng) * std::log((double)range)) - 1;
+      query = rank * 2654435761LL % range;
+    } else {
+      query = uniform(rng);
+    }
+  }
+  if (stream == Sorted) std::sort(queries.begin(), queries.end());
+  return queries;
+}
+
+// Builds one search structure and times a full batch of every query stream
+// through it. nsPerQuery[s] is the median time per query for stream s.
+template <typename Search>
+bool timeBatchVariant(const std::string& name, const std::vector<int>& array,
+                      const std::vector<int> (&queries)[NumStreams], int executions,
+                      int numThreads, double (&nsPerQuery)[NumStreams]) {
+  Search search(array);
+  std::vector<int> results(QUERIES_PER_BATCH);
+
+  for (int s = 0; s < NumStreams; s++) {
+    std::span<const int> batch(queries[s]);
+    searchBatch(search, batch, std::span<int>(results), numThreads);
+    for (int i = 0; i < 4096; i++) {
+      if (results[i] != binarySearch(array, batch[i])) {
+        std::cerr << name << " batch disagrees with binarySearch at size "
+                  << array.size() << std::endl;
+        return false;
+      }
+    }
+
+    bench::Options opts;
+    opts.minSamples = executions;
+    opts.maxSeconds = 0.25;
+    bench::Result result = bench::run(
+      name + "/batch/" + streamNames[s] + "/threads=" + std::to_string(numThreads) +
+      "/size=" + std::to_string(array.size()), [&]() {
+        searchBatch(search, batch, std::span<int>(results), numThreads);
+        bench::clobberMemory();
+      }, opts);
+    benchResults.push_back(result);
+    nsPerQuery[s] = result.median / QUERIES_PER_BATCH * 1e9;
+  }
+  return true;
+}
+
+// Times findBatch over random, Zipfian and sorted streams of
+// QUERIES_PER_BATCH independent queries
+bool runBatchTests(int executions, int numThreads) {
+  const char* variants[] = {"binary", "branchless", "eytzinger", "stree", "interpolation"};
+  std::mt19937 rng(42);
+
+  std::cout << "Median Time per Query in Batches of " << QUERIES_PER_BATCH
+            << " (ns), " << numThreads << " thread(s)" << std::endl;
+  std::cout << std::setw(10) << std::right << "Size" << " | "
+            << std::setw(8) << std::left << "Stream";
+  for (const char* variant : variants) {
+    std::cout << " | " << std::setw(13) << std::right << variant;
+  }
+  std::cout << std::endl;
+
+  for (int size : arraySizes) {
+    std::vector<int> array = createBinarySearchableArray(size);
+    std::vector<int> queries[NumStreams];
+    for (int s = 0; s < NumStreams; s++) {
+      queries[s] = createQueries(QueryStream(s), size, rng);
+    }
+
+    double times[5][NumStreams];
+    bool ok =
+      timeBatchVariant<BinarySearch>("binarySearch", array, queries, executions, numThreads, times[0]) &&
+      timeBatchVariant<BranchlessSearch>("branchless", array, queries, executions, numThreads, times[1]) &&
+      timeBatchVariant<EytzingerSearch>("eytzinger", array, queries, executions, numThreads, times[2]) &&
+      timeBatchVariant<STreeSearch>("stree", array, queries, executions, numThreads, times[3]) &&
+      timeBatchVariant<InterpolationSearch>("interpolation", array, queries, executions, numThreads, times[4]);
+    if (!ok) return false;
+
+    for (int s = 0; s < NumStreams; s++) {
+      std::cout << std::setw(10) << std::right << size << " | "
+                << std::setw(8) << std::left << streamNames[s];
+      for (int v = 0; v < 5; v++) {
+        std::cout << " | " << std::setw(13) << std::right << std::fixed
+                  << std::setprecision(1) << times[v][s];
+      }
+      std::cout << std::endl;
+    }
   }
+  return true;
 }
 
+// Usage: test <executions> [batch threads, default all cores]
 int main(int argc, char* argv[]) 
 {
-  runTests(std::stoi(argv[1]));
-  return 0;
+  int numThreads = argc > 2 ? std::stoi(argv[2])
+                            : std::max(1u, std::thread::hardware_concurrency());
+  bool ok = agreesOnFullRangeKeys<BranchlessSearch>("branchless") &&
+            agreesOnFullRangeKeys<EytzingerSearch>("eytzinger") &&
+            agreesOnFullRangeKeys<STreeSearch>("stree") &&
+            agreesOnFullRangeKeys<InterpolationSearch>("interpolation") &&
+            runTests(std::stoi(argv[1])) && runBatchTests(std::stoi(argv[1]), numThreads);
+  bench::writeReports(benchResults);
+  return ok ? 0 : 1;
 } 
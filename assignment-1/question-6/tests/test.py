@@ -1,3 +1,4 @@
+import os
 import time
 import sys
 
@@ -44,6 +45,19 @@ def getAverageExecutionTime(func, array, target, executions):
     return totalTime / executions / 1_000_000_000  # Convert to seconds
 
 
+# When started by runTests, every time is also written as a
+# "name,size,seconds" line to the pipe it passes in BENCH_RESULTS_FD
+resultsPipe = None
+if "BENCH_RESULTS_FD" in os.environ:
+    resultsPipe = os.fdopen(int(os.environ["BENCH_RESULTS_FD"]), "w")
+
+
+def reportResult(name, size, seconds):
+    if resultsPipe is not None:
+        resultsPipe.write(f"{name},{size},{seconds:.6f}\n")
+        resultsPipe.flush()
+
+
 def runTests(executions):
     arraySizes = [100, 400, 1600, 6400, 25600, 102400, 409600, 1638400]
 
@@ -58,6 +72,7 @@ def runTests(executions):
         print(
             f"Array size: {size}, Average Execution Time for 30,000,000 Unsuccessful Searches: {averageExecutionTime:.3f} (s)"
         )
+        reportResult("binarySearch", size, averageExecutionTime)
 
 
 if __name__ == "__main__":
@@ -58,6 +58,15 @@ const getAverageExecutionTime = (
   return totalTime / executions / 1_000_000_000; // Convert to seconds
 };
 
+// When started by runTests, every time is also written as a
+// "name,size,seconds" line to the pipe it passes in BENCH_RESULTS_FD
+const reportResult = (name: string, size: number, seconds: number) => {
+  const fd = process.env.BENCH_RESULTS_FD;
+  if (fd !== undefined) {
+    require("fs").writeSync(Number(fd), `${name},${size},${seconds.toFixed(6)}\n`);
+  }
+};
+
 const runTests = (executions: number) => {
   const arraySizes = [100, 400, 1600, 6400, 25600, 102400, 409600, 1638400];
 
@@ -78,6 +87,7 @@ const runTests = (executions: number) => {
         3
       )} (s)`
     );
+    reportResult("binarySearch", size, averageExecutionTime);
   }
 };
 
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "huffman.h"
+
+// Seekable container of independently Huffman-coded blocks:
+//
+//   "HUFB"  u32 alphabetSize  u32 blockSymbols  u32 numBlocks  u64 totalSymbols
+//   index:  numBlocks x (u64 offset, u64 bytes), offsets from the container start
+//   blocks: varint used, used x (varint symbol gap, u8 code length), payload
+//
+// Every block but the last holds blockSymbols symbols and carries the code
+// lengths of its own canonical code, so any block decodes on its own and
+// blocks encode and decode in parallel. Integers are little-endian.
+
+constexpr size_t defaultBlockSymbols = 1 << 18;
+
+// Runs f(i) for i in [0, count) on numThreads threads, each taking the next
+// index as it finishes one, so uneven items still balance. The first
+// exception any f(i) throws is rethrown once all threads stop.
+template <typename F>
+void parallelFor(size_t count, int numThreads, F f) {
+  std::atomic<size_t> next(0);
+  std::exception_ptr error;
+  std::mutex errorMutex;
+  auto work = [&]() {
+    try {
+      for (size_t i = next++; i < count; i = next++) {
+        f(i);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if (!error) error = std::current_exception();
+      next = count;
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int t = 1; t < numThreads && (size_t)t < count; t++) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+namespace blockformat {
+
+constexpr char magic[4] = {'H', 'U', 'F', 'B'};
+constexpr size_t headerBytes = 4 + 4 + 4 + 4 + 8;
+constexpr size_t indexEntryBytes = 16;
+
+template <typename T>
+void put(std::vector<uint8_t>& out, T value) {
+  uint8_t bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T get(const uint8_t* in) {
+  T value;
+  std::memcpy(&value, in, sizeof(T));
+  return value;
+}
+
+inline void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(uint8_t(value) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(uint8_t(value));
+}
+
+inline uint64_t getVarint(const uint8_t*& in, const uint8_t* end) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (in == end) break;
+    uint8_t byte = *in++;
+    value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return value;
+  }
+  throw std::runtime_error("Corrupt block header");
+}
+
+// Code-length header and payload of one block
+template <typename Symbol>
+std::vector<uint8_t> encodeBlock(std::span<const Symbol> block, int alphabetSize) {
+  CanonicalCode code = canonicalCodeFor(histogram(block, alphabetSize));
+
+  std::vector<uint8_t> out;
+  uint64_t used = 0;
+  for (uint8_t length : code.lengths) used += length > 0;
+  putVarint(out, used);
+  int previous = -1;
+  for (int sym = 0; sym < code.alphabetSize(); sym++) {
+    if (code.lengths[sym] == 0) continue;
+    putVarint(out, sym - previous - 1);
+    out.push_back(code.lengths[sym]);
+    previous = sym;
+  }
+
+  std::vector<uint8_t> payload = encode(block, code);
+  out.insert(out.end(), payload.begin(), payload.end());
+  return out;
+}
+
+}  // namespace blockformat
+
+// Splits data, a contiguous range of integer symbols, into blocks of
+// blockSymbols and encodes them on numThreads threads
+template <typename Symbols>
+std::vector<uint8_t> compressBlocks(const Symbols& symbols, int alphabetSize, int numThreads,
+                                    size_t blockSymbols = defaultBlockSymbols) {
+  using namespace blockformat;
+  std::span data(symbols);
+  size_t numBlocks = (data.size() + blockSymbols - 1) / blockSymbols;
+  std::vector<std::vector<uint8_t>> blocks(numBlocks);
+  parallelFor(numBlocks, numThreads, [&](size_t b) {
+    blocks[b] = encodeBlock(data.subspan(b * blockSymbols,
+                                         std::min(blockSymbols, data.size() - b * blockSymbols)),
+                            alphabetSize);
+  });
+
+  std::vector<uint8_t> out(magic, magic + 4);
+  put<uint32_t>(out, alphabetSize);
+  put<uint32_t>(out, blockSymbols);
+  put<uint32_t>(out, numBlocks);
+  put<uint64_t>(out, data.size());
+
+  uint64_t offset = headerBytes + numBlocks * indexEntryBytes;
+  for (const auto& block : blocks) {
+    put<uint64_t>(out, offset);
+    put<uint64_t>(out, block.size());
+    offset += block.size();
+  }
+  out.reserve(offset);
+  for (const auto& block : blocks) {
+    out.insert(out.end(), block.begin(), block.end());
+  }
+  return out;
+}
+
+// Read-only view of a container; the bytes must outlive it
+class BlockContainer {
+public:
+  struct IndexEntry {
+    uint64_t offset;
+    uint64_t bytes;
+  };
+
+  explicit BlockContainer(std::span<const uint8_t> bytes) : bytes(bytes) {
+    using namespace blockformat;
+    if (bytes.size() < headerBytes || std::memcmp(bytes.data(), magic, 4) != 0) {
+      throw std::runtime_error("Not a block container");
+    }
+    alphabetSize = get<uint32_t>(bytes.data() + 4);
+    blockSymbols = get<uint32_t>(bytes.data() + 8);
+    uint32_t numBlocks = get<uint32_t>(bytes.data() + 12);
+    totalSymbols = get<uint64_t>(bytes.data() + 16);
+    if (bytes.size() < headerBytes + uint64_t(numBlocks) * indexEntryBytes ||
+        (numBlocks > 0 && blockSymbols == 0) ||
+        (totalSymbols + blockSymbols - 1) / std::max(blockSymbols, 1u) != numBlocks) {
+      throw std::runtime_error("Corrupt block container header");
+    }
+
+    for (uint32_t b = 0; b < numBlocks; b++) {
+      const uint8_t* entry = bytes.data() + headerBytes + b * indexEntryBytes;
+      IndexEntry e{get<uint64_t>(entry), get<uint64_t>(entry + 8)};
+      if (e.offset > bytes.size() || e.bytes > bytes.size() - e.offset) {
+        throw std::runtime_error("Corrupt block index");
+      }
+      index.push_back(e);
+    }
+  }
+
+  size_t numBlocks() const { return index.size(); }
+
+  size_t size() const { return totalSymbols; }
+
+  uint32_t alphabet() const { return alphabetSize; }
+
+  uint32_t symbolsPerBlock() const { return blockSymbols; }
+
+  size_t blockStart(size_t b) const { return b * blockSymbols; }
+
+  size_t blockSize(size_t b) const {
+    return std::min<uint64_t>(blockSymbols, totalSymbols - blockStart(b));
+  }
+
+  // Decodes block b into out, which has room for blockSize(b) symbols
+  template <typename Symbol>
+  void decodeBlock(size_t b, Symbol* out) const {
+    using namespace blockformat;
+    const uint8_t* in = bytes.data() + index[b].offset;
+    const uint8_t* end = in + index[b].bytes;
+
+    std::vector<uint8_t> lengths(alphabetSize, 0);
+    uint64_t used = getVarint(in, end);
+    // No longer than the encoder would write, which bounds the decoder tables
+    int maxLength = codeLengthLimit((int)std::min<uint64_t>(used, INT_MAX));
+    int64_t sym = -1;
+    for (uint64_t i = 0; i < used; i++) {
+      // Checked before the add, so a huge gap cannot wrap sym
+      uint64_t gap = getVarint(in, end);
+      if (gap >= alphabetSize - uint64_t(sym + 1) || in == end) {
+        throw std::runtime_error("Corrupt block header");
+      }
+      sym += gap + 1;
+      lengths[sym] = *in++;
+      if (lengths[sym] > maxLength) throw std::runtime_error("Corrupt block header");
+    }
+
+    HuffmanDecoder decoder{CanonicalCode(lengths)};
+    decoder.decode(in, end - in, out, blockSize(b));
+  }
+
+  std::vector<int> decodeBlock(size_t b) const {
+    std::vector<int> decoded(blockSize(b));
+    decodeBlock(b, decoded.data());
+    return decoded;
+  }
+
+  // Decodes every block into out, which has room for size() symbols
+  template <typename Symbol>
+  void decodeAll(Symbol* out, int numThreads) const {
+    parallelFor(numBlocks(), numThreads, [&](size_t b) {
+      decodeBlock(b, out + blockStart(b));
+    });
+  }
+
+  std::vector<int> decodeAll(int numThreads) const {
+    std::vector<int> decoded(totalSymbols);
+    decodeAll(decoded.data(), numThreads);
+    return decoded;
+  }
+
+private:
+  std::span<const uint8_t> bytes;
+  uint32_t alphabetSize = 0;
+  uint32_t blockSymbols = 0;
+  uint64_t totalSymbols = 0;
+  std::vector<IndexEntry> index;
+};
@@ -0,0 +1,323 @@
+// Byte-file Huffman compressor built on the block container:
+//
+//   huffman compress <input> <output> [--threads T] [--chunk-mb M]
+//   huffman decompress <input> <output> [--threads T]
+//
+// The input is mapped and handled M MiB at a time (64 by default). Each
+// chunk gets two passes, a byte histogram per block and then the encode,
+// and goes out as its own block container before the next one is read,
+// so memory stays a small multiple of the chunk size for any file size.
+//
+//   "HUF1"  u64 originalBytes  u32 chunkBytes
+//   per chunk: u64 containerBytes, block container over byte symbols
+//   u32 CRC-32C of the original bytes
+//
+// Decompression checks the size and the checksum.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "huffman-blocks.h"
+
+const char fileMagic[4] = {'H', 'U', 'F', '1'};
+
+// CRC-32C (Castagnoli), which SSE4.2 computes eight bytes per instruction
+class Crc32c {
+public:
+  Crc32c() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = crc & 1 ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+      }
+      table[i] = crc;
+    }
+    hardware = hasSSE42();
+  }
+
+  void update(const uint8_t* data, size_t size) {
+    crc = hardware ? updateSSE42(crc, data, size) : updateTable(crc, data, size);
+  }
+
+  uint32_t value() const { return ~crc; }
+
+private:
+  uint32_t updateTable(uint32_t crc, const uint8_t* data, size_t size) const {
+    for (size_t i = 0; i < size; i++) {
+      crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+  }
+
+#if defined(__GNUC__) && defined(__x86_64__)
+  __attribute__((target("sse4.2")))
+  static uint32_t updateSSE42(uint32_t crc, const uint8_t* data, size_t size) {
+    uint64_t crc64 = crc;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+      uint64_t word;
+      std::memcpy(&word, data + i, 8);
+      crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = crc64;
+    for (; i < size; i++) {
+      crc = _mm_crc32_u8(crc, data[i]);
+    }
+    return crc;
+  }
+
+  static bool hasSSE42() { return __builtin_cpu_supports("sse4.2"); }
+#else
+  uint32_t updateSSE42(uint32_t crc, const uint8_t* data, size_t size) const {
+    return updateTable(crc, data, size);
+  }
+
+  static bool hasSSE42() { return false; }
+#endif
+
+  uint32_t table[256];
+  uint32_t crc = ~0u;
+  bool hardware;
+};
+
+// Read-only mapping of a whole file
+class MappedFile {
+public:
+  MappedFile(const std::string& path) {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw std::runtime_error("Cannot stat " + path);
+    }
+    size = st.st_size;
+    if (size > 0) {
+      void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Cannot map " + path);
+      }
+      data = static_cast<const uint8_t*>(p);
+      madvise(p, size, MADV_SEQUENTIAL);
+    }
+  }
+
+  ~MappedFile() {
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+    if (fd >= 0) close(fd);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Lets the kernel drop pages that are done with, so resident memory
+  // stays near one chunk; offset must be page aligned
+  void release(size_t offset, size_t length) {
+    if (length > 0) madvise(const_cast<uint8_t*>(data) + offset, length, MADV_DONTNEED);
+  }
+
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+
+private:
+  int fd = -1;
+};
+
+class OutputFile {
+public:
+  OutputFile(const std::string& path) : file(std::fopen(path.c_str(), "wb")) {
+    if (!file) throw std::runtime_error("Cannot open " + path);
+  }
+
+  ~OutputFile() {
+    if (file) std::fclose(file);
+  }
+
+  void write(const void* data, size_t size) {
+    if (std::fwrite(data, 1, size, file) != size) {
+      throw std::runtime_error("Write failed");
+    }
+    written += size;
+  }
+
+  template <typename T>
+  void put(T value) { write(&value, sizeof(T)); }
+
+  void close() {
+    if (std::fclose(file) != 0) throw std::runtime_error("Write failed");
+    file = nullptr;
+  }
+
+  uint64_t written = 0;
+
+private:
+  FILE* file;
+};
+
+class InputFile {
+public:
+  InputFile(const std::string& path) : file(std::fopen(path.c_str(), "rb")) {
+    if (!file) throw std::runtime_error("Cannot open " + path);
+  }
+
+  ~InputFile() { std::fclose(file); }
+
+  void read(void* data, size_t size) {
+    if (std::fread(data, 1, size, file) != size) {
+      throw std::runtime_error("Truncated input");
+    }
+    consumed += size;
+  }
+
+  template <typename T>
+  T get() {
+    T value;
+    read(&value, sizeof(T));
+    return value;
+  }
+
+  uint64_t consumed = 0;
+
+private:
+  FILE* file;
+};
+
+struct Stats {
+  uint64_t originalBytes;
+  uint64_t compressedBytes;
+  double seconds;
+  uint32_t checksum;
+};
+
+Stats compressFile(const std::string& inputPath, const std::string& outputPath,
+                   int numThreads, size_t chunkBytes) {
+  auto start = std::chrono::steady_clock::now();
+  MappedFile input(inputPath);
+  OutputFile output(outputPath);
+  Crc32c crc;
+
+  output.write(fileMagic, 4);
+  output.put<uint64_t>(input.size);
+  output.put<uint32_t>(chunkBytes);
+
+  for (size_t offset = 0; offset < input.size; offset += chunkBytes) {
+    std::span<const uint8_t> chunk(input.data + offset, std::min(chunkBytes, input.size - offset));
+    crc.update(chunk.data(), chunk.size());
+    std::vector<uint8_t> container = compressBlocks(chunk, 256, numThreads);
+    output.put<uint64_t>(container.size());
+    output.write(container.data(), container.size());
+    input.release(offset, chunk.size());
+  }
+
+  output.put<uint32_t>(crc.value());
+  output.close();
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return {input.size, output.written, seconds, crc.value()};
+}
+
+Stats decompressFile(const std::string& inputPath, const std::string& outputPath,
+                     int numThreads) {
+  auto start = std::chrono::steady_clock::now();
+  InputFile input(inputPath);
+  OutputFile output(outputPath);
+  Crc32c crc;
+
+  char magic[4];
+  input.read(magic, 4);
+  if (std::memcmp(magic, fileMagic, 4) != 0) {
+    throw std::runtime_error("Not a huffman file");
+  }
+  uint64_t originalBytes = input.get<uint64_t>();
+  uint64_t chunkBytes = input.get<uint32_t>();
+  if (chunkBytes == 0 && originalBytes > 0) throw std::runtime_error("Corrupt file header");
+
+  std::vector<uint8_t> container, decoded;
+  for (uint64_t offset = 0; offset < originalBytes; offset += chunkBytes) {
+    uint64_t containerBytes = input.get<uint64_t>();
+    // A chunk never compresses to much more than its own size
+    if (containerBytes > 2 * chunkBytes + (1 << 20)) {
+      throw std::runtime_error("Corrupt chunk size");
+    }
+    container.resize(containerBytes);
+    input.read(container.data(), containerBytes);
+
+    BlockContainer blocks(container);
+    // Only what compressFile writes: bytes, in blocks of the default size.
+    // Anything else would size every block's code table from the file.
+    if (blocks.size() != std::min(chunkBytes, originalBytes - offset) || blocks.alphabet() != 256 ||
+        blocks.symbolsPerBlock() != defaultBlockSymbols) {
+      throw std::runtime_error("Corrupt chunk");
+    }
+    decoded.resize(blocks.size());
+    blocks.decodeAll(decoded.data(), numThreads);
+    crc.update(decoded.data(), decoded.size());
+    output.write(decoded.data(), decoded.size());
+  }
+
+  if (input.get<uint32_t>() != crc.value()) {
+    throw std::runtime_error("Checksum mismatch");
+  }
+  output.close();
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return {originalBytes, input.consumed, seconds, crc.value()};
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0] << " compress|decompress <input> <output>"
+              << " [--threads T] [--chunk-mb M]" << std::endl;
+    return 1;
+  }
+
+  std::string mode = argv[1];
+  int numThreads = std::max(1u, std::thread::hardware_concurrency());
+  size_t chunkMB = 64;
+  for (int i = 4; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    if (arg == "--threads") numThreads = std::max(1, std::stoi(argv[i + 1]));
+    else if (arg == "--chunk-mb") chunkMB = std::clamp(std::stoi(argv[i + 1]), 1, 2047);
+  }
+
+  Stats stats;
+  try {
+    if (mode == "compress") {
+      stats = compressFile(argv[2], argv[3], numThreads, chunkMB << 20);
+    } else if (mode == "decompress") {
+      stats = decompressFile(argv[2], argv[3], numThreads);
+    } else {
+      std::cerr << "Unknown mode " << mode << std::endl;
+      return 1;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << argv[2] << ": " << e.what() << std::endl;
+    return 1;
+  }
+
+  double ratio = stats.compressedBytes > 0 ? (double)stats.originalBytes / stats.compressedBytes : 0;
+  std::cerr << std::fixed << std::setprecision(3) << mode << ": "
+            << stats.originalBytes << " bytes <-> " << stats.compressedBytes << " bytes"
+            << ", ratio " << ratio << ", " << stats.seconds << " s, "
+            << std::setprecision(1) << stats.originalBytes / 1e6 / std::max(stats.seconds, 1e-9)
+            << " MB/s, CRC-32C " << std::hex << std::setw(8) << std::setfill('0')
+            << stats.checksum << std::endl;
+  return 0;
+}
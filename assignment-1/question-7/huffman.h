@@ -0,0 +1,425 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <bit>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// Canonical Huffman code over int symbols [0, alphabet size). Only the code
+// lengths come from the tree: within each length, codes are consecutive
+// integers assigned in symbol order, and every shorter code sorts before
+// every longer one, so the lengths alone describe the whole code.
+struct CanonicalCode {
+  // Longest code the 64-bit BitWriter can take after a flush
+  static constexpr int maxCodeLength = 57;
+
+  std::vector<uint64_t> codes;  // right-aligned, indexed by symbol
+  std::vector<uint8_t> lengths; // 0 for symbols that do not occur
+
+  CanonicalCode() = default;
+
+  explicit CanonicalCode(const std::vector<uint8_t>& codeLengths)
+    : codes(codeLengths.size(), 0), lengths(codeLengths) {
+    int maxLength = 0;
+    for (uint8_t length : lengths) {
+      if (length > maxCodeLength) {
+        throw std::invalid_argument("Code length exceeds 57 bits");
+      }
+      maxLength = std::max<int>(maxLength, length);
+    }
+
+    std::vector<uint64_t> count(maxLength + 1, 0);
+    for (uint8_t length : lengths) {
+      if (length > 0) count[length]++;
+    }
+
+    // First code of each length
+    std::vector<uint64_t> next(maxLength + 1, 0);
+    uint64_t code = 0;
+    for (int length = 1; length <= maxLength; length++) {
+      code = (code + count[length - 1]) << 1;
+      next[length] = code;
+    }
+
+    for (size_t sym = 0; sym < lengths.size(); sym++) {
+      if (lengths[sym] == 0) continue;
+      codes[sym] = next[lengths[sym]]++;
+      if (codes[sym] >> lengths[sym]) {
+        throw std::invalid_argument("Code lengths oversubscribe the code space");
+      }
+    }
+  }
+
+  int alphabetSize() const { return lengths.size(); }
+};
+
+// Symbol counts for data over symbols [0, alphabetSize). Here and below,
+// Symbols is any range of integer symbols, such as std::vector<int> or
+// std::span<const uint8_t>.
+template <typename Symbols>
+std::vector<uint64_t> histogram(const Symbols& data, int alphabetSize) {
+  std::vector<uint64_t> freq(alphabetSize, 0);
+  for (int sym : data) {
+    freq[sym]++;
+  }
+  return freq;
+}
+
+// Symbols that occur, in increasing frequency order (ties by symbol).
+// Frequencies are usually small next to the alphabet, and then a counting
+// sort keeps this linear too.
+inline std::vector<int> sortedByFrequency(const std::vector<uint64_t>& freq) {
+  std::vector<int> symbols;
+  uint64_t maxFreq = 0;
+  for (size_t sym = 0; sym < freq.size(); sym++) {
+    if (freq[sym] > 0) symbols.push_back(sym);
+    maxFreq = std::max(maxFreq, freq[sym]);
+  }
+
+  if (maxFreq > std::max<uint64_t>(symbols.size(), 1 << 16)) {
+    std::stable_sort(symbols.begin(), symbols.end(),
+                     [&](int a, int b) { return freq[a] < freq[b]; });
+    return symbols;
+  }
+
+  std::vector<int> start(maxFreq + 2, 0);
+  for (int sym : symbols) start[freq[sym] + 1]++;
+  for (uint64_t f = 1; f <= maxFreq + 1; f++) start[f] += start[f - 1];
+  std::vector<int> sorted(symbols.size());
+  for (int sym : symbols) sorted[start[freq[sym]]++] = sym;
+  return sorted;
+}
+
+// Huffman tree in one index-based node array, built with the two-queue
+// method: once the leaves are sorted by frequency, merged nodes are created
+// in nondecreasing weight order too, so the two lightest nodes are always
+// at the front of one of the two queues and the build is linear.
+struct HuffmanTree {
+  // Nodes [0, leaves) are the leaves in increasing frequency order, then
+  // the merged nodes in creation order, so every parent comes after its
+  // children and the last node is the root
+  std::vector<int> symbols;  // symbol of each leaf
+  std::vector<uint64_t> weights;
+  std::vector<int> parent;   // -1 for the root
+
+  static HuffmanTree fromFrequencies(const std::vector<uint64_t>& freq) {
+    HuffmanTree tree;
+    tree.symbols = sortedByFrequency(freq);
+
+    int leaves = tree.symbols.size();
+    if (leaves == 0) return tree;
+    tree.weights.resize(2 * leaves - 1);
+    tree.parent.assign(2 * leaves - 1, -1);
+    for (int i = 0; i < leaves; i++) tree.weights[i] = freq[tree.symbols[i]];
+
+    // Fronts of the leaf queue and of the merged-node queue
+    int leaf = 0, merged = leaves;
+    auto lightest = [&](int created) {
+      if (leaf < leaves && (merged == created || tree.weights[leaf] <= tree.weights[merged])) {
+        return leaf++;
+      }
+      return merged++;
+    };
+
+    for (int created = leaves; created < 2 * leaves - 1; created++) {
+      int a = lightest(created);
+      int b = lightest(created);
+      tree.weights[created] = tree.weights[a] + tree.weights[b];
+      tree.parent[a] = tree.parent[b] = created;
+    }
+    return tree;
+  }
+
+  int leafCount() const { return symbols.size(); }
+
+  // Depth of every leaf, indexed by symbol, found by walking the nodes
+  // from the root down (parents first) instead of recursing
+  std::vector<uint8_t> codeLengths(int alphabetSize) const {
+    std::vector<uint8_t> lengths(alphabetSize, 0);
+    int nodes = parent.size();
+    if (nodes == 0) return lengths;
+    if (nodes == 1) {
+      lengths[symbols[0]] = 1;
+      return lengths;
+    }
+
+    std::vector<int> depth(nodes, 0);
+    for (int i = nodes - 2; i >= 0; i--) {
+      depth[i] = depth[parent[i]] + 1;
+    }
+    for (int i = 0; i < leafCount(); i++) {
+      lengths[symbols[i]] = std::min(depth[i], 255);
+    }
+    return lengths;
+  }
+};
+
+// Longest code the decoder tables are built for, unless the alphabet needs
+// more: 2^20 codes keep the second-level tables within L2
+inline int codeLengthLimit(int usedSymbols) {
+  return std::max(20, (int)std::bit_width((unsigned)std::max(usedSymbols - 1, 1)));
+}
+
+// Optimal code lengths no longer than maxLength (package-merge). Each of
+// maxLength levels merges the leaves, sorted by frequency, with pairs
+// ("packages") of the level below; the cheapest 2 * (used - 1) items of the
+// top level fix the lengths. Items taken at a level are always a prefix of
+// its list, so only which positions are leaves needs to be kept, and each
+// leaf in a taken prefix adds one to its symbol's length.
+inline std::vector<uint8_t> limitedCodeLengths(const std::vector<uint64_t>& freq,
+                                               int maxLength) {
+  std::vector<uint8_t> lengths(freq.size(), 0);
+  std::vector<int> symbols = sortedByFrequency(freq);
+  int used = symbols.size();
+  if (used == 0) return lengths;
+  if (used == 1) {
+    lengths[symbols[0]] = 1;
+    return lengths;
+  }
+  if (used > (1LL << std::min(maxLength, 62))) {
+    throw std::invalid_argument("Too many symbols for the code length limit");
+  }
+
+  // isLeaf[level][i]: item i of that level's list is a leaf
+  std::vector<std::vector<uint8_t>> isLeaf(maxLength);
+  std::vector<uint64_t> items(used), merged;
+  for (int i = 0; i < used; i++) items[i] = freq[symbols[i]];
+  isLeaf[0].assign(used, 1);
+
+  for (int level = 1; level < maxLength; level++) {
+    merged.clear();
+    isLeaf[level].clear();
+    size_t leaf = 0, pair = 0, pairs = items.size() / 2;
+    while (leaf < (size_t)used || pair < pairs) {
+      uint64_t package = pair < pairs ? items[2 * pair] + items[2 * pair + 1] : 0;
+      if (pair == pairs || (leaf < (size_t)used && freq[symbols[leaf]] <= package)) {
+        merged.push_back(freq[symbols[leaf++]]);
+        isLeaf[level].push_back(1);
+      } else {
+        merged.push_back(package);
+        isLeaf[level].push_back(0);
+        pair++;
+      }
+    }
+    items.swap(merged);
+  }
+
+  size_t take = 2 * (used - 1);
+  for (int level = maxLength - 1; level >= 0 && take > 0; level--) {
+    size_t leaves = 0;
+    for (size_t i = 0; i < take; i++) leaves += isLeaf[level][i];
+    for (size_t i = 0; i < leaves; i++) lengths[symbols[i]]++;
+    take = 2 * (take - leaves);
+  }
+  return lengths;
+}
+
+// MSB-first bit writer into a caller-sized buffer. Bits collect at the top
+// of a 64-bit accumulator, and whole bytes go out with one 8-byte store, so
+// the buffer needs 8 bytes of slack past the last byte written.
+class BitWriter {
+public:
+  static constexpr size_t slack = 8;
+
+  BitWriter(uint8_t* out) : begin(out), out(out) {}
+
+  // Appends the low `length` bits of code, 1 <= length <= 57
+  void put(uint64_t code, int length) {
+    if (bits + length > 64) flush();
+    acc |= code << (64 - bits - length);
+    bits += length;
+  }
+
+  // Writes out the partial last byte, padded with zero bits, and returns
+  // the number of bytes written in total
+  size_t finish() {
+    flush();
+    if (bits > 0) {
+      out++;
+      bits = 0;
+      acc = 0;
+    }
+    return out - begin;
+  }
+
+private:
+  void flush() {
+    uint64_t word = __builtin_bswap64(acc);
+    std::memcpy(out, &word, sizeof(word));
+    int bytes = bits >> 3;
+    out += bytes;
+    acc = bytes == 8 ? 0 : acc << (bytes * 8);
+    bits &= 7;
+  }
+
+  uint8_t* begin;
+  uint8_t* out;
+  uint64_t acc = 0;
+  int bits = 0;
+};
+
+// Encoded size in bytes, counted from the code lengths of the data
+template <typename Symbols>
+size_t encodedSize(const Symbols& data, const CanonicalCode& code) {
+  uint64_t bits = 0;
+  for (int sym : data) {
+    bits += code.lengths[sym];
+  }
+  return (bits + 7) / 8;
+}
+
+template <typename Symbols>
+std::vector<uint8_t> encode(const Symbols& data, const CanonicalCode& code) {
+  std::vector<uint8_t> encoded(encodedSize(data, code) + BitWriter::slack);
+  BitWriter writer(encoded.data());
+  for (int sym : data) {
+    writer.put(code.codes[sym], code.lengths[sym]);
+  }
+  encoded.resize(writer.finish());
+  return encoded;
+}
+
+// Canonical code with Huffman code lengths for freq, or package-merge
+// lengths if the tree is deeper than the decoder tables allow
+inline CanonicalCode canonicalCodeFor(const std::vector<uint64_t>& freq) {
+  HuffmanTree tree = HuffmanTree::fromFrequencies(freq);
+  std::vector<uint8_t> lengths = tree.codeLengths(freq.size());
+
+  int limit = codeLengthLimit(tree.leafCount());
+  if (!lengths.empty() && *std::max_element(lengths.begin(), lengths.end()) > limit) {
+    lengths = limitedCodeLengths(freq, limit);
+  }
+  return CanonicalCode(lengths);
+}
+
+// Table-driven decoder for a canonical code. The next tableBits bits index
+// a primary table whose entries hold up to two symbols whose codes both fit
+// in those bits. Longer codes share a primary entry per tableBits-bit
+// prefix, which points at a second-level table indexed by the bits that
+// follow. Codes must be no longer than tableBits + 25.
+class HuffmanDecoder {
+public:
+  HuffmanDecoder(const CanonicalCode& code, int tableBits = 11) : tableBits(tableBits) {
+    int size = 1 << tableBits;
+    // Bits that cannot start a code decode as symbol -1
+    std::vector<Entry> single(size, Entry{{-1, -1}, 1, (uint8_t)tableBits});
+
+    // Longest code under each prefix of long codes, which sizes its table
+    std::vector<uint8_t> subBits(size, 0);
+    for (int sym = 0; sym < code.alphabetSize(); sym++) {
+      int length = code.lengths[sym];
+      if (length == 0) continue;
+      if (length > tableBits + 25) {
+        throw std::invalid_argument("Code too long for the decoder tables");
+      }
+      if (length <= tableBits) {
+        uint64_t first = code.codes[sym] << (tableBits - length);
+        for (uint64_t i = 0; i < (uint64_t(1) << (tableBits - length)); i++) {
+          single[first + i] = Entry{{sym, -1}, 1, (uint8_t)length};
+        }
+      } else {
+        uint64_t prefix = code.codes[sym] >> (length - tableBits);
+        subBits[prefix] = std::max<int>(subBits[prefix], length - tableBits);
+      }
+    }
+
+    for (int prefix = 0; prefix < size; prefix++) {
+      if (subBits[prefix] == 0) continue;
+      single[prefix] = Entry{{(int)secondary.size(), -1}, 0, subBits[prefix]};
+      secondary.resize(secondary.size() + (size_t(1) << subBits[prefix]),
+                       Entry{{-1, -1}, 1, (uint8_t)(tableBits + subBits[prefix])});
+    }
+    for (int sym = 0; sym < code.alphabetSize(); sym++) {
+      int length = code.lengths[sym];
+      if (length <= tableBits) continue;
+      int extra = length - tableBits;
+      uint64_t prefix = code.codes[sym] >> extra;
+      const Entry& link = single[prefix];
+      uint64_t suffix = code.codes[sym] & ((uint64_t(1) << extra) - 1);
+      uint64_t first = link.symbols[0] + (suffix << (link.bits - extra));
+      for (uint64_t i = 0; i < (uint64_t(1) << (link.bits - extra)); i++) {
+        secondary[first + i] = Entry{{sym, -1}, 1, (uint8_t)length};
+      }
+    }
+
+    // Pair each short code with the code after it when both fit
+    primary = single;
+    for (int i = 0; i < size; i++) {
+      const Entry& first = single[i];
+      if (first.count != 1 || first.symbols[0] < 0 || first.bits >= tableBits) continue;
+      const Entry& second = single[(i << first.bits) & (size - 1)];
+      if (second.count == 1 && second.symbols[0] >= 0 &&
+          first.bits + second.bits <= tableBits) {
+        primary[i] = Entry{{first.symbols[0], second.symbols[0]}, 2,
+                           (uint8_t)(first.bits + second.bits)};
+      }
+    }
+  }
+
+  std::vector<int> decode(const std::vector<uint8_t>& encoded, size_t originalSize) const {
+    std::vector<int> decoded(originalSize);
+    decode(encoded.data(), encoded.size(), decoded.data(), originalSize);
+    return decoded;
+  }
+
+  // Decodes count symbols from bytes of encoded data into out. Symbol can
+  // be narrower than int when the alphabet fits in it.
+  template <typename Symbol>
+  void decode(const uint8_t* encoded, size_t bytes, Symbol* out, size_t count) const {
+    size_t done = 0, bitPos = 0;
+
+    // Two free slots, so a two-symbol entry can be stored unconditionally
+    while (done + 1 < count) {
+      uint64_t window = peek(encoded, bytes, bitPos);
+      const Entry& entry = primary[window >> (64 - tableBits)];
+      if (entry.count == 0) {
+        const Entry& sub = secondary[entry.symbols[0] +
+                                     ((window << tableBits) >> (64 - entry.bits))];
+        out[done++] = sub.symbols[0];
+        bitPos += sub.bits;
+      } else {
+        out[done] = entry.symbols[0];
+        out[done + 1] = entry.symbols[1];
+        done += entry.count;
+        bitPos += entry.bits;
+      }
+    }
+
+    if (done < count) {
+      uint64_t window = peek(encoded, bytes, bitPos);
+      const Entry& entry = primary[window >> (64 - tableBits)];
+      out[done] = entry.count != 0 ? entry.symbols[0]
+                : secondary[entry.symbols[0] +
+                            ((window << tableBits) >> (64 - entry.bits))].symbols[0];
+    }
+  }
+
+private:
+  // count 0 links to a second-level table: symbols[0] is its offset and
+  // bits its index width. Otherwise bits is the total length consumed.
+  struct Entry {
+    int32_t symbols[2];
+    uint8_t count;
+    uint8_t bits;
+  };
+
+  // The next 64 bits from bitPos, MSB first; at least 57 are valid, and
+  // bits past the end read as zero
+  static uint64_t peek(const uint8_t* encoded, size_t bytes, size_t bitPos) {
+    size_t byte = bitPos >> 3;
+    uint64_t word = 0;
+    if (byte + 8 <= bytes) {
+      std::memcpy(&word, encoded + byte, 8);
+    } else if (byte < bytes) {
+      std::memcpy(&word, encoded + byte, bytes - byte);
+    }
+    return __builtin_bswap64(word) << (bitPos & 7);
+  }
+
+  int tableBits;
+  std::vector<Entry> primary;
+  std::vector<Entry> secondary;
+};
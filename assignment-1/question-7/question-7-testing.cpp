@@ -1,180 +1,230 @@
 #include <iostream>
-#include <queue>
 #include <vector>
-#include <unordered_map>
 #include <string>
-#include <random>
-#include <chrono>
+#include <sstream>
+#include <algorithm>
 #include <bitset>
 #include <cmath>
 
-// int symbols for testing
-struct HuffmanNode {
-  int sym;
-  uint64_t freq;
-  HuffmanNode* left;
-  HuffmanNode* right;
-  HuffmanNode(int sym, uint64_t freq) : 
-    sym(sym), freq(freq), left(nullptr), right(nullptr) {}
-};
-
-struct Compare {
-  bool operator()(HuffmanNode* a, HuffmanNode* b) const {
-    return a->freq > b->freq;
-  }
-};
-
-HuffmanNode* buildHuffmanTree(const std::vector<int>& data) {
-  std::unordered_map<int, uint64_t> freq;
-  
-  for (int sym : data) {
-    freq[sym]++;
-  }
-
-  std::priority_queue<HuffmanNode*, std::vector<HuffmanNode*>, Compare> pq;
+#include "../../common/bench.h"
+#include "../../common/rng.h"
+#include "huffman.h"
+#include "huffman-blocks.h"
+#include "rans.h"
 
-  for (const auto& [sym, f] : freq) {
-    pq.push(new HuffmanNode(sym, f));
-  }
-
-  if (pq.empty()) return nullptr;
-
-  while (pq.size() > 1) {
-    HuffmanNode* left = pq.top(); 
-    pq.pop();
-    HuffmanNode* right = pq.top(); 
-    pq.pop();
-    HuffmanNode* parent = new HuffmanNode(-1, left->freq + right->freq);
-    parent->left = left;
-    parent->right = right;
-    pq.push(parent);
-  }
+// Canonical code for symbols [0, alphabetSize) of data
+CanonicalCode getCanonicalCode(const std::vector<int>& data, int alphabetSize) {
+  return canonicalCodeFor(histogram(data, alphabetSize));
+}
 
-  return pq.top();
+// generate n random symbols with values in range [0, sigma-1]
+std::vector<int> generateSymbols(int n, int sigma) {
+  std::vector<int> data(n);
+  rng::Generator gen(rng::randomSeed());
+  gen.fillUniform(data.data(), data.size(), 0, sigma - 1);
+  return data;
 }
 
-void generateCodes(const HuffmanNode* node, const std::string& path,
-                   std::unordered_map<int, std::string>& codeMap) {
-  if (!node) return;
+std::vector<bench::Result> benchResults;
 
-  if (!node->left && !node->right) {
-    codeMap[node->sym] = path.empty() ? "0" : path; 
-    return;
-  }
-
-  generateCodes(node->left, path + "0", codeMap);
-  generateCodes(node->right, path + "1", codeMap);
-}
+struct Timings {
+  double build, encode, decode;  // ms
+  double bitsPerSymbol;          // payload only, without the code table
+};
 
-std::unordered_map<int, std::string> getCodeMap(const HuffmanNode* root) {
-  std::unordered_map<int, std::string> codeMap;
-  generateCodes(root, "", codeMap);
-  return codeMap;
+std::string formatTimings(const Timings& t) {
+  std::ostringstream out;
+  out << "Median Build Time = " << t.build << " ms, "
+      << "Median Encode Time = " << t.encode << " ms, "
+      << "Median Decode Time = " << t.decode << " ms, "
+      << "Bits/Symbol = " << t.bitsPerSymbol;
+  return out.str();
 }
 
-std::vector<uint8_t> encode(const std::vector<int>& data,
-                            const std::unordered_map<int, std::string>& codeMap) {
-  std::vector<uint8_t> encoded;
-  uint8_t currentByte = 0;
-  int bitPos = 0;
-
-  for (int sym : data) {
-    const std::string& code = codeMap.at(sym);
-    for (char bit : code) {
-      if (bit == '1') {
-        currentByte |= (1 << (7 - bitPos));
-      }
-      bitPos++;
-      if (bitPos == 8) {
-        encoded.push_back(currentByte);
-        currentByte = 0;
-        bitPos = 0;
-      }
-    }
-  }
-
-  if (bitPos > 0) {
-    encoded.push_back(currentByte);
+// Huffman median times in ms from at least numberOfExecutions samples
+// each: build (tree and canonical code), encode (bit packing only) and
+// decode
+Timings getHuffmanExecutionTime(const std::vector<int>& data, int sigma,
+                                int numberOfExecutions) {
+  std::string suffix = "/n=" + std::to_string(data.size()) + "/sigma=" + std::to_string(sigma);
+  bench::Options opts;
+  opts.minSamples = numberOfExecutions;
+
+  bench::Result buildResult = bench::runManual("huffman/build" + suffix, [&]() {
+    bench::Clock::time_point start = bench::Clock::now();
+    CanonicalCode code = getCanonicalCode(data, sigma);
+    bench::doNotOptimize(code.codes.data());
+    double elapsed = bench::secondsSince(start);
+
+    // Freeing the code is not part of the build
+    return elapsed;
+  }, opts);
+
+  CanonicalCode code = getCanonicalCode(data, sigma);
+
+  bench::Result encodeResult = bench::run("huffman/encode" + suffix, [&]() {
+    std::vector<uint8_t> encoded = encode(data, code);
+    bench::doNotOptimize(encoded.data());
+  }, opts);
+
+  HuffmanDecoder decoder(code);
+  std::vector<uint8_t> encoded = encode(data, code);
+  bench::Result decodeResult = bench::run("huffman/decode" + suffix, [&]() {
+    std::vector<int> decoded = decoder.decode(encoded, data.size());
+    bench::doNotOptimize(decoded.data());
+  }, opts);
+  if (decoder.decode(encoded, data.size()) != data) {
+    std::cerr << "Round trip failed" << suffix << std::endl;
   }
 
-  return encoded;
+  benchResults.push_back(buildResult);
+  benchResults.push_back(encodeResult);
+  benchResults.push_back(decodeResult);
+  return {buildResult.median * 1000.0, encodeResult.median * 1000.0,
+          decodeResult.median * 1000.0, encoded.size() * 8.0 / data.size()};
 }
 
-std::vector<int> decode(const std::vector<uint8_t>& encoded, const HuffmanNode* root, size_t originalSize) {
-  if (!root) return {};
-
-  std::vector<int> decoded;
-  decoded.reserve(originalSize);
-
-  if (!root->left && !root->right) {
-    decoded.resize(originalSize, root->sym);
-    return decoded;
-  }
-
-  const HuffmanNode* current = root;
-  for (uint8_t byte : encoded) {
-    for (int i = 7; i >= 0 && decoded.size() < originalSize; i--) {
-      bool bit = (byte >> i) & 1;
-      current = bit ? current->right : current->left;
-      if (!current->left && !current->right) {
-        decoded.push_back(current->sym);
-        current = root;
-      }
-    }
-    if (decoded.size() >= originalSize) break;
+// The same for 4-way interleaved rANS on the same symbol counts: build
+// (histogram, normalized frequencies and decode table), encode and decode
+Timings getRansExecutionTime(const std::vector<int>& data, int sigma,
+                             int numberOfExecutions) {
+  std::string suffix = "/n=" + std::to_string(data.size()) + "/sigma=" + std::to_string(sigma);
+  bench::Options opts;
+  opts.minSamples = numberOfExecutions;
+
+  bench::Result buildResult = bench::runManual("rans/build" + suffix, [&]() {
+    bench::Clock::time_point start = bench::Clock::now();
+    RansCoder coder(histogram(data, sigma));
+    bench::doNotOptimize(coder);
+    return bench::secondsSince(start);
+  }, opts);
+
+  RansCoder coder(histogram(data, sigma));
+  bench::Result encodeResult = bench::run("rans/encode" + suffix, [&]() {
+    std::vector<uint32_t> encoded = coder.encode(data);
+    bench::doNotOptimize(encoded.data());
+  }, opts);
+
+  std::vector<uint32_t> encoded = coder.encode(data);
+  bench::Result decodeResult = bench::run("rans/decode" + suffix, [&]() {
+    std::vector<int> decoded = coder.decode(encoded, data.size());
+    bench::doNotOptimize(decoded.data());
+  }, opts);
+  if (coder.decode(encoded, data.size()) != data) {
+    std::cerr << "rANS round trip failed" << suffix << std::endl;
   }
 
-  return decoded;
+  benchResults.push_back(buildResult);
+  benchResults.push_back(encodeResult);
+  benchResults.push_back(decodeResult);
+  return {buildResult.median * 1000.0, encodeResult.median * 1000.0,
+          decodeResult.median * 1000.0, encoded.size() * 32.0 / data.size()};
 }
 
-void deleteTree(HuffmanNode* node) {
-  if (!node) return;
-  deleteTree(node->left);
-  deleteTree(node->right);
-  delete node;
+// Runs both coders on one random input and prints a line for each
+void printCoderTimings(int exponent, int sigma, const std::string& sigmaLabel,
+                       int numberOfExecutions) {
+  int n = 1 << exponent;
+  std::vector<int> data = generateSymbols(n, sigma);
+  Timings huffman = getHuffmanExecutionTime(data, sigma, numberOfExecutions);
+  Timings rans = getRansExecutionTime(data, sigma, numberOfExecutions);
+
+  std::cout << "n = 2^" << exponent << " (" << n << "), "
+            << "sigma = " << sigmaLabel << ":\n"
+            << "  Huffman: " << formatTimings(huffman) << "\n"
+            << "  rANS:    " << formatTimings(rans) << "\n";
 }
 
-// generate n random symbols with values in range [0, sigma-1]
-std::vector<int> generateSymbols(int n, int sigma) {
-  std::vector<int> data;
-  data.reserve(n);
-
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<int> dist(0, sigma - 1);
-
-  for (int i = 0; i < n; i++) {
-    data.push_back(dist(gen));
+// Times the block container on n symbols: parallel compress and
+// decompress on numThreads threads, and decoding one block on its own
+void printBlockTimings(int n, int sigma, int numThreads) {
+  std::vector<int> data = generateSymbols(n, sigma);
+  std::string suffix = "/n=" + std::to_string(n) + "/sigma=" + std::to_string(sigma) +
+                       "/threads=" + std::to_string(numThreads);
+  bench::Options opts;
+  opts.minSamples = 3;
+
+  std::vector<uint8_t> compressed;
+  bench::Result compressResult = bench::run("blocks/compress" + suffix, [&]() {
+    compressed = compressBlocks(data, sigma, numThreads);
+    bench::doNotOptimize(compressed.data());
+  }, opts);
+
+  BlockContainer container(compressed);
+  bench::Result decompressResult = bench::run("blocks/decompress" + suffix, [&]() {
+    std::vector<int> decoded = container.decodeAll(numThreads);
+    bench::doNotOptimize(decoded.data());
+  }, opts);
+
+  size_t middle = container.numBlocks() / 2;
+  bench::Result blockResult = bench::run("blocks/decodeBlock" + suffix, [&]() {
+    std::vector<int> decoded = container.decodeBlock(middle);
+    bench::doNotOptimize(decoded.data());
+  }, opts);
+
+  std::vector<int> block = container.decodeBlock(middle);
+  if (container.decodeAll(numThreads) != data ||
+      !std::equal(block.begin(), block.end(), data.begin() + container.blockStart(middle))) {
+    std::cerr << "Block round trip failed" << suffix << std::endl;
   }
 
-  return data;
+  benchResults.push_back(compressResult);
+  benchResults.push_back(decompressResult);
+  benchResults.push_back(blockResult);
+
+  double inputMB = n * sizeof(int) / 1e6;
+  std::cout << "n = " << n << ", sigma = " << sigma << ", " << container.numBlocks()
+            << " blocks, " << numThreads << " threads: "
+            << "Compress = " << compressResult.median * 1000.0 << " ms ("
+            << inputMB / compressResult.median << " MB/s), "
+            << "Decompress = " << decompressResult.median * 1000.0 << " ms ("
+            << inputMB / decompressResult.median << " MB/s), "
+            << "One Block = " << blockResult.median * 1000.0 << " ms, "
+            << "Bits/Symbol = " << compressed.size() * 8.0 / n << "\n";
 }
 
-std::pair<double, double> getAverageExecutionTime(int n, int sigma, int numberOfExecutions) {
-  double totalEncodeTime = 0.0;
-  double totalDecodeTime = 0.0;
-
-  for (int i = 0; i < numberOfExecutions; i++) {
-    std::vector<int> data = generateSymbols(n, sigma);
-
-    // Encode 
-    auto start = std::chrono::high_resolution_clock::now();
-    HuffmanNode* root = buildHuffmanTree(data);
-    auto codeMap = getCodeMap(root);
-    std::vector<uint8_t> encoded = encode(data, codeMap);
-    auto end = std::chrono::high_resolution_clock::now();
-    totalEncodeTime += std::chrono::duration<double, std::milli>(end - start).count();
-
-    // Decode
-    start = std::chrono::high_resolution_clock::now();
-    std::vector<int> decoded = decode(encoded, root, data.size());
-    end = std::chrono::high_resolution_clock::now();
-    totalDecodeTime += std::chrono::duration<double, std::milli>(end - start).count();
-
-    deleteTree(root);
+// Decodes a one-block container around the given block header and payload,
+// which must throw rather than write outside the lengths or build tables
+// for codes the encoder never writes
+void checkCorruptBlock(const std::string& what, const std::vector<uint8_t>& block) {
+  using namespace blockformat;
+  std::vector<uint8_t> bytes(magic, magic + 4);
+  put<uint32_t>(bytes, 16);  // alphabetSize
+  put<uint32_t>(bytes, 1);   // blockSymbols
+  put<uint32_t>(bytes, 1);   // numBlocks
+  put<uint64_t>(bytes, 1);   // totalSymbols
+  put<uint64_t>(bytes, headerBytes + indexEntryBytes);
+  put<uint64_t>(bytes, block.size());
+  bytes.insert(bytes.end(), block.begin(), block.end());
+
+  try {
+    BlockContainer(bytes).decodeBlock(0);
+    std::cerr << "Corrupt block header (" << what << ") was not rejected" << std::endl;
+  } catch (const std::runtime_error&) {
   }
+}
 
-  return {totalEncodeTime / numberOfExecutions, totalDecodeTime / numberOfExecutions};
+void checkCorruptContainers() {
+  using namespace blockformat;
+  // Symbol 0, then a gap that wraps past 2^63
+  std::vector<uint8_t> block;
+  putVarint(block, 2);
+  putVarint(block, 0);
+  block.push_back(1);
+  putVarint(block, ~uint64_t(0) - 1000);
+  block.push_back(1);
+  block.push_back(0);
+  checkCorruptBlock("wrapping gap", block);
+
+  // Two symbols, one with a code longer than the encoder's limit
+  block.clear();
+  putVarint(block, 2);
+  putVarint(block, 0);
+  block.push_back(1);
+  putVarint(block, 0);
+  block.push_back(36);
+  block.push_back(0);
+  checkCorruptBlock("code too long", block);
 }
 
 int main() 
@@ -184,60 +234,49 @@ int main()
 
   std::cout << "sigma = 256\n";
   for (int i = 0; i < exponents.size(); i++) {
-    int n = std::pow(2, exponents[i]);
-    int sigma = 256;
-
-    auto [avgEncodeTime, avgDecodeTime] = getAverageExecutionTime(n, sigma, numberOfExecutions);
-    std::cout << "n = 2^" << exponents[i] << " (" << n << "), "
-              << "sigma = " << sigma << ": "
-              << "Avg Encode Time = " << avgEncodeTime << " ms, "
-              << "Avg Decode Time = " << avgDecodeTime << " ms\n";
+    printCoderTimings(exponents[i], 256, "256", numberOfExecutions);
   }
 
   std::cout << std::endl;
 
   std::cout << "sigma = sqrt(n)\n";
   for (int i = 0; i < exponents.size(); i++) {
-    int n = std::pow(2, exponents[i]);
-    int sigma = std::sqrt(n);
-
-    auto [avgEncodeTime, avgDecodeTime] = getAverageExecutionTime(n, sigma, numberOfExecutions);
-    std::cout << "n = 2^" << exponents[i] << " (" << n << "), "
-              << "sigma = sqrt(n) = " << sigma << ": "
-              << "Avg Encode Time = " << avgEncodeTime << " ms, "
-              << "Avg Decode Time = " << avgDecodeTime << " ms\n";
+    int sigma = std::sqrt(1 << exponents[i]);
+    printCoderTimings(exponents[i], sigma, "sqrt(n) = " + std::to_string(sigma),
+                      numberOfExecutions);
   }
 
   std::cout << std::endl;
 
   std::cout << "sigma = n/10\n";
   for (int i = 0; i < exponents.size(); i++) {
-    int n = std::pow(2, exponents[i]);
-    int sigma = n / 10;
-
-    auto [avgEncodeTime, avgDecodeTime] = getAverageExecutionTime(n, sigma, numberOfExecutions);
-    std::cout << "n = 2^" << exponents[i] << " (" << n << "), "
-              << "sigma = n/10 = " << sigma << ": "
-              << "Avg Encode Time = " << avgEncodeTime << " ms, "
-              << "Avg Decode Time = " << avgDecodeTime << " ms\n";
+    int sigma = (1 << exponents[i]) / 10;
+    printCoderTimings(exponents[i], sigma, "n/10 = " + std::to_string(sigma),
+                      numberOfExecutions);
   }
 
   std::cout << std::endl;
 
   std::cout << "sigma = n\n";
   for (int i = 0; i < exponents.size(); i++) {
-    int n = std::pow(2, exponents[i]);
-    int sigma = n;
-
-    auto [avgEncodeTime, avgDecodeTime] = getAverageExecutionTime(n, sigma, numberOfExecutions);
-    std::cout << "n = 2^" << exponents[i] << " (" << n << "), "
-              << "sigma = n = " << sigma << ": "
-              << "Avg Encode Time = " << avgEncodeTime << " ms, "
-              << "Avg Decode Time = " << avgDecodeTime << " ms\n";
+    int sigma = 1 << exponents[i];
+    printCoderTimings(exponents[i], sigma, "n = " + std::to_string(sigma),
+                      numberOfExecutions);
+  }
+
+  std::cout << std::endl;
+
+  std::cout << "Block container\n";
+  int numThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (int sigma : {256, 1 << 16}) {
+    printBlockTimings(1 << 24, sigma, 1);
+    if (numThreads > 1) printBlockTimings(1 << 24, sigma, numThreads);
   }
+  checkCorruptContainers();
 
   std::cout << std::endl;
 
+  bench::writeReports(benchResults);
   return 0;
 }
 
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// Static range ANS coder over int symbols [0, alphabet size), with four
+// interleaved states so consecutive symbols form independent dependency
+// chains. Counts are scaled to frequencies summing to 2^scaleBits, which
+// replace Huffman's whole-bit code lengths with fractional ones.
+//
+// States are 64-bit and renormalize 32 bits at a time (as in ryg's
+// rans64), which leaves room for the 2^20+ totals large alphabets need.
+// Symbol i uses state i % 4. The encoder runs backwards and pushes words
+// onto a stack that the decoder then pops forwards.
+class RansCoder {
+public:
+  static constexpr uint64_t lowerBound = uint64_t(1) << 31;
+  static constexpr int ways = 4;
+  static constexpr int maxScaleBits = 24;
+
+  // Every used symbol needs a frequency of at least 1 out of 2^scaleBits,
+  // so more than 2^maxScaleBits of them cannot be coded
+  explicit RansCoder(const std::vector<uint64_t>& counts)
+    : freq(counts.size(), 0), start(counts.size(), 0) {
+    size_t used = std::count_if(counts.begin(), counts.end(), [](uint64_t c) { return c > 0; });
+    if (used > (size_t(1) << maxScaleBits)) {
+      throw std::invalid_argument("Too many symbols for rANS");
+    }
+    scaleBits = std::clamp((int)std::bit_width(used) + 2, 14, maxScaleBits);
+    normalize(counts);
+
+    slotSymbol.resize(size_t(1) << scaleBits);
+    uint32_t cumulative = 0;
+    for (size_t sym = 0; sym < counts.size(); sym++) {
+      start[sym] = cumulative;
+      std::fill_n(slotSymbol.begin() + cumulative, freq[sym], (int)sym);
+      cumulative += freq[sym];
+    }
+  }
+
+  int scaleBits;
+
+  std::vector<uint32_t> encode(std::span<const int> data) const {
+    // At most one word per symbol, since scaleBits < 32, plus the flush
+    std::vector<uint32_t> words(data.size() + 2 * ways);
+    uint32_t* out = words.data() + words.size();
+
+    uint64_t state[ways];
+    std::fill_n(state, ways, lowerBound);
+    for (size_t i = data.size(); i-- > 0;) {
+      uint64_t& x = state[i % ways];
+      uint32_t f = freq[data[i]];
+      uint64_t xMax = ((lowerBound >> scaleBits) << 32) * f;
+      if (x >= xMax) {
+        *--out = (uint32_t)x;
+        x >>= 32;
+      }
+      x = ((x / f) << scaleBits) + (x % f) + start[data[i]];
+    }
+
+    for (int w = ways - 1; w >= 0; w--) {
+      *--out = (uint32_t)(state[w] >> 32);
+      *--out = (uint32_t)state[w];
+    }
+
+    words.erase(words.begin(), words.begin() + (out - words.data()));
+    return words;
+  }
+
+  void decode(const std::vector<uint32_t>& words, int* out, size_t count) const {
+    if (words.size() < 2 * ways) throw std::runtime_error("Truncated rANS stream");
+    const uint32_t* in = words.data();
+    const uint32_t* end = words.data() + words.size();
+    uint64_t mask = (uint64_t(1) << scaleBits) - 1;
+
+    uint64_t state[ways];
+    for (int w = 0; w < ways; w++) {
+      state[w] = in[0] | uint64_t(in[1]) << 32;
+      in += 2;
+    }
+
+    size_t i = 0;
+    for (; i + ways <= count; i += ways) {
+      for (int w = 0; w < ways; w++) {
+        uint64_t& x = state[w];
+        int sym = slotSymbol[x & mask];
+        out[i + w] = sym;
+        x = freq[sym] * (x >> scaleBits) + (x & mask) - start[sym];
+        if (x < lowerBound && in < end) x = x << 32 | *in++;
+      }
+    }
+    for (; i < count; i++) {
+      uint64_t& x = state[i % ways];
+      int sym = slotSymbol[x & mask];
+      out[i] = sym;
+      x = freq[sym] * (x >> scaleBits) + (x & mask) - start[sym];
+      if (x < lowerBound && in < end) x = x << 32 | *in++;
+    }
+  }
+
+  std::vector<int> decode(const std::vector<uint32_t>& words, size_t count) const {
+    std::vector<int> decoded(count);
+    decode(words, decoded.data(), count);
+    return decoded;
+  }
+
+private:
+  // Scales counts to sum to 2^scaleBits, keeping every used symbol at
+  // least 1, then settles the rounding error on the largest frequencies
+  void normalize(const std::vector<uint64_t>& counts) {
+    uint64_t total = std::accumulate(counts.begin(), counts.end(), uint64_t(0));
+    if (total == 0) return;
+    int64_t target = int64_t(1) << scaleBits;
+
+    int64_t sum = 0;
+    for (size_t sym = 0; sym < counts.size(); sym++) {
+      if (counts[sym] == 0) continue;
+      freq[sym] = std::max<uint64_t>(1, (unsigned __int128)counts[sym] * target / total);
+      sum += freq[sym];
+    }
+
+    std::vector<int> bySize;
+    for (size_t sym = 0; sym < counts.size(); sym++) {
+      if (freq[sym] > 0) bySize.push_back(sym);
+    }
+    std::sort(bySize.begin(), bySize.end(), [&](int a, int b) { return freq[a] > freq[b]; });
+
+    // Rounding down only ever leaves the sum short, except where the
+    // minimum of 1 pushed it over
+    if (sum < target) {
+      freq[bySize[0]] += target - sum;
+    }
+    while (sum > target) {
+      for (int sym : bySize) {
+        if (sum == target) break;
+        int64_t take = std::min<int64_t>({sum - target, freq[sym] - 1,
+                                          std::max<int64_t>(1, freq[sym] / 4)});
+        freq[sym] -= take;
+        sum -= take;
+      }
+    }
+  }
+
+  std::vector<uint32_t> freq;
+  std::vector<uint32_t> start;
+  std::vector<int> slotSymbol;
+};
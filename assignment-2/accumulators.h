@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "update-engine.h"
+
+// Interchangeable stores for the sums of an n x n update workload. Each one
+// has
+//
+//   explicit Acc(int n);
+//   void add(int row, int col, int value);
+//   int get(int row, int col) const;
+//   size_t memoryBytes() const;   // heap bytes held right now
+//
+// and the benchmark takes the backend as a template parameter, so add()
+// inlines into the update loop.
+
+// Every cell up front, in one DenseMatrix with the given layout
+template <typename Layout = RowMajorLayout>
+class DenseAccumulator {
+public:
+  explicit DenseAccumulator(int n) : matrix(n) {}
+
+  void add(int row, int col, int value) { matrix(row, col) += value; }
+
+  int get(int row, int col) const { return matrix(row, col); }
+
+  size_t memoryBytes() const { return matrix.cellCount() * sizeof(int); }
+
+  void readRowMajor(int* out) const { matrix.readRowMajor(out); }
+
+private:
+  DenseMatrix<Layout> matrix;
+};
+
+// Open-addressing hash map from cell index to sum, with linear probing, so
+// memory follows the number of distinct cells touched rather than n^2.
+// The table doubles at 70% load. Growing past the size of the dense matrix
+// would lose the point, so that throws std::length_error instead.
+class HashAccumulator {
+public:
+  explicit HashAccumulator(int n)
+    : n(n), maxBytes(uint64_t(n) * n * sizeof(int)) {
+    if (n > 65535) throw std::invalid_argument("Matrix too large for 32-bit cell indices");
+    // Starting small enough that even the first table is no larger than
+    // dense, but at 2 entries or more, since 1 would make the shift 64
+    rehash(std::min<size_t>(1024, std::max<size_t>(2, std::bit_floor(maxBytes / sizeof(Entry)))));
+  }
+
+  void add(int row, int col, int value) {
+    uint32_t key = uint32_t(row) * n + col;
+    for (size_t i = slot(key);; i = (i + 1) & mask) {
+      if (table[i].key == key) {
+        table[i].value += value;
+        return;
+      }
+      if (table[i].key == emptyKey) {
+        if ((used + 1) * 10 > table.size() * 7) {
+          grow();
+          add(row, col, value);
+          return;
+        }
+        table[i] = {key, value};
+        used++;
+        return;
+      }
+    }
+  }
+
+  int get(int row, int col) const {
+    uint32_t key = uint32_t(row) * n + col;
+    for (size_t i = slot(key);; i = (i + 1) & mask) {
+      if (table[i].key == key) return table[i].value;
+      if (table[i].key == emptyKey) return 0;
+    }
+  }
+
+  size_t memoryBytes() const { return table.size() * sizeof(Entry); }
+
+  size_t distinctCells() const { return used; }
+
+private:
+  struct Entry {
+    uint32_t key;
+    int32_t value;
+  };
+
+  // n <= 65535 keeps every cell index below this
+  static constexpr uint32_t emptyKey = 0xffffffff;
+
+  // Fibonacci hashing: the top bits of key times 2^64 / golden ratio
+  size_t slot(uint32_t key) const {
+    return (key * 0x9e3779b97f4a7c15) >> shift;
+  }
+
+  void grow() {
+    if (table.size() * 2 * sizeof(Entry) > maxBytes) {
+      throw std::length_error("Hash accumulator outgrew the dense matrix");
+    }
+    rehash(table.size() * 2);
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<Entry> old(capacity, Entry{emptyKey, 0});
+    old.swap(table);
+    mask = capacity - 1;
+    shift = 64 - std::countr_zero(capacity);
+    for (const Entry& e : old) {
+      if (e.key == emptyKey) continue;
+      size_t i = slot(e.key);
+      while (table[i].key != emptyKey) i = (i + 1) & mask;
+      table[i] = e;
+    }
+  }
+
+  int n;
+  uint64_t maxBytes;
+  std::vector<Entry> table;
+  size_t mask = 0;
+  int shift = 0;
+  size_t used = 0;
+};
+
+// The matrix cut into tileSide x tileSide tiles, each allocated (zeroed) on
+// the first update that lands in it; untouched tiles cost one null pointer
+class TiledAccumulator {
+public:
+  static constexpr int tileBits = 6;
+  static constexpr int tileSide = 1 << tileBits;  // 64 x 64 ints, 16 KiB
+  static constexpr size_t tileCells = size_t(tileSide) * tileSide;
+
+  explicit TiledAccumulator(int n)
+    : tilesPerRow((n + tileSide - 1) / tileSide), tiles(size_t(tilesPerRow) * tilesPerRow) {}
+
+  void add(int row, int col, int value) {
+    std::unique_ptr<int[]>& tile = tiles[size_t(row >> tileBits) * tilesPerRow + (col >> tileBits)];
+    if (!tile) {
+      tile = std::make_unique<int[]>(tileCells);
+      allocated++;
+    }
+    tile[offset(row, col)] += value;
+  }
+
+  int get(int row, int col) const {
+    const std::unique_ptr<int[]>& tile = tiles[size_t(row >> tileBits) * tilesPerRow + (col >> tileBits)];
+    return tile ? tile[offset(row, col)] : 0;
+  }
+
+  size_t memoryBytes() const {
+    return tiles.size() * sizeof(tiles[0]) + allocated * tileCells * sizeof(int);
+  }
+
+private:
+  static size_t offset(int row, int col) {
+    return size_t(row & (tileSide - 1)) << tileBits | (col & (tileSide - 1));
+  }
+
+  int tilesPerRow;
+  std::vector<std::unique_ptr<int[]>> tiles;
+  size_t allocated = 0;
+};
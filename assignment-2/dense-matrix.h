@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Where cell (row, col) of an n x n matrix lives in its storage. Each
+// layout has
+//
+//   explicit Layout(int n);
+//   size_t storageCells() const;              // may pad past n * n
+//   size_t index(int row, int col) const;
+//   static constexpr const char* name;
+
+// Rows one after another
+class RowMajorLayout {
+public:
+  static constexpr const char* name = "row-major";
+
+  explicit RowMajorLayout(int n) : n(n) {}
+
+  size_t storageCells() const { return size_t(n) * n; }
+
+  size_t index(int row, int col) const { return size_t(row) * n + col; }
+
+private:
+  int n;
+};
+
+// 32 x 32 tiles of ints, one 4 KiB page each, stored row-major within the
+// tile and tile after tile in row-major order. Neighbouring cells in both
+// directions share a page, so a random update walks 32x fewer pages per
+// row of tiles than per row of the matrix.
+class PageTiledLayout {
+public:
+  static constexpr const char* name = "page-tiled";
+  static constexpr int tileBits = 5;
+  static constexpr int tileSide = 1 << tileBits;
+
+  explicit PageTiledLayout(int n) : tilesPerRow((n + tileSide - 1) / tileSide) {}
+
+  size_t storageCells() const { return size_t(tilesPerRow) * tilesPerRow * tileSide * tileSide; }
+
+  size_t index(int row, int col) const {
+    size_t tile = size_t(row >> tileBits) * tilesPerRow + (col >> tileBits);
+    return tile << (2 * tileBits) | size_t(row & (tileSide - 1)) << tileBits |
+           (col & (tileSide - 1));
+  }
+
+private:
+  int tilesPerRow;
+};
+
+// Z-order: the bits of row and col interleaved, so every aligned 2^k x 2^k
+// block is contiguous at every k. The side is padded to a power of two.
+class MortonLayout {
+public:
+  static constexpr const char* name = "morton";
+
+  explicit MortonLayout(int n) : side(1) {
+    while (side < n) side *= 2;
+  }
+
+  size_t storageCells() const { return size_t(side) * side; }
+
+  size_t index(int row, int col) const { return spread(row) << 1 | spread(col); }
+
+private:
+  // Moves bit i of x to bit 2i
+  static uint64_t spread(uint32_t x) {
+    uint64_t v = x;
+    v = (v | v << 16) & 0x0000ffff0000ffff;
+    v = (v | v << 8) & 0x00ff00ff00ff00ff;
+    v = (v | v << 4) & 0x0f0f0f0f0f0f0f0f;
+    v = (v | v << 2) & 0x3333333333333333;
+    v = (v | v << 1) & 0x5555555555555555;
+    return v;
+  }
+
+  int side;
+};
+
+// n x n int matrix in one contiguous allocation, arranged by Layout
+template <typename Layout = RowMajorLayout>
+class DenseMatrix {
+public:
+  explicit DenseMatrix(int n) : n(n), layout(n), cells(layout.storageCells(), 0) {}
+
+  int size() const { return n; }
+
+  size_t cellCount() const { return cells.size(); }
+
+  int& operator()(int row, int col) { return cells[layout.index(row, col)]; }
+
+  int operator()(int row, int col) const { return cells[layout.index(row, col)]; }
+
+  int* data() { return cells.data(); }
+
+  const int* data() const { return cells.data(); }
+
+  // Copies the matrix into out, n * n ints in row-major order. Other
+  // layouts are read an aligned 32 x 32 block at a time, which is one tile
+  // or one contiguous Morton block, so reads stay within a page.
+  void readRowMajor(int* out) const {
+    if constexpr (std::is_same_v<Layout, RowMajorLayout>) {
+      std::memcpy(out, cells.data(), size_t(n) * n * sizeof(int));
+    } else {
+      constexpr int block = 32;
+      for (int r0 = 0; r0 < n; r0 += block) {
+        for (int c0 = 0; c0 < n; c0 += block) {
+          for (int row = r0; row < std::min(r0 + block, n); row++) {
+            for (int col = c0; col < std::min(c0 + block, n); col++) {
+              out[size_t(row) * n + col] = cells[layout.index(row, col)];
+            }
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<int> readRowMajor() const {
+    std::vector<int> out(size_t(n) * n);
+    readRowMajor(out.data());
+    return out;
+  }
+
+private:
+  int n;
+  Layout layout;
+  std::vector<int> cells;
+};
+
+// The row-major matrix that the update engine and parallel strategies
+// index directly as row * n + col
+using FlatMatrix = DenseMatrix<RowMajorLayout>;
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "update-engine.h"
+
+// Three ways to apply m random updates to a FlatMatrix on several threads.
+// Thread t draws its m / numThreads updates from stream t of the seed, so
+// every strategy sees the same updates for the same seed and thread count.
+
+enum class ParallelStrategy { RowOwner, Atomic, Private };
+
+inline const char* strategyName(ParallelStrategy strategy) {
+  switch (strategy) {
+    case ParallelStrategy::RowOwner: return "row-owner";
+    case ParallelStrategy::Atomic: return "atomic";
+    case ParallelStrategy::Private: return "private";
+  }
+  return "?";
+}
+
+// Runs f(t) for t in [0, numThreads), on the calling thread for t = 0
+template <typename F>
+void runThreads(int numThreads, F f) {
+  std::vector<std::thread> workers;
+  for (int t = 1; t < numThreads; t++) {
+    workers.emplace_back(f, t);
+  }
+  f(0);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+inline long long updatesForThread(long long m, int numThreads, int t) {
+  return m / numThreads + (t < m % numThreads);
+}
+
+// Bounded single-producer single-consumer ring of updates. Head and tail
+// sit on their own cache lines so the two sides do not share one.
+class SpscQueue {
+public:
+  static constexpr size_t capacity = 1024;  // a power of two
+
+  // Pushes all count updates or, if they do not fit, none
+  bool tryPush(const Update* items, size_t count) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (capacity - (t - head.load(std::memory_order_acquire)) < count) return false;
+    for (size_t i = 0; i < count; i++) {
+      slots[(t + i) & (capacity - 1)] = items[i];
+    }
+    tail.store(t + count, std::memory_order_release);
+    return true;
+  }
+
+  // Calls f(update) for everything queued so far; returns how many
+  template <typename F>
+  size_t drain(F f) {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_acquire);
+    for (size_t i = h; i != t; i++) {
+      f(slots[i & (capacity - 1)]);
+    }
+    head.store(t, std::memory_order_release);
+    return t - h;
+  }
+
+private:
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+  alignas(64) Update slots[capacity];
+};
+
+// Thread t owns rows [t * n / P, (t + 1) * n / P) and is the only one to
+// write them. Every thread generates updates, applies those for its own
+// rows and sends the rest, in batches, through queue[from][to] to the
+// owner. A thread whose send finds the queue full drains its own inbox
+// while it waits, so two full threads cannot deadlock.
+inline void applyRowOwner(FlatMatrix& matrix, long long m, int numThreads, uint64_t seed) {
+  constexpr size_t batch = 64;
+  int n = matrix.size();
+  int P = std::max(1, std::min(numThreads, n));
+  int* cells = matrix.data();
+
+  std::vector<std::unique_ptr<SpscQueue>> queues;
+  for (int q = 0; q < P * P; q++) queues.push_back(std::make_unique<SpscQueue>());
+  std::atomic<int> producing(P);
+
+  runThreads(P, [&](int me) {
+    auto apply = [&](const Update& u) { cells[u.cell] += u.value; };
+    auto drainInbox = [&]() {
+      size_t drained = 0;
+      for (int from = 0; from < P; from++) {
+        drained += queues[from * P + me]->drain(apply);
+      }
+      return drained;
+    };
+
+    std::vector<Update> staging(size_t(P) * batch);
+    std::vector<size_t> staged(P, 0);
+    auto send = [&](int to) {
+      while (!queues[me * P + to]->tryPush(&staging[to * batch], staged[to])) {
+        if (drainInbox() == 0) std::this_thread::yield();
+      }
+      staged[to] = 0;
+    };
+
+    UpdateGenerator updates(n, seed, me);
+    long long left = updatesForThread(m, P, me);
+    while (left > 0) {
+      long long k = std::min<long long>(left, UpdateGenerator::chunk);
+      updates.generate(k, [&](int row, int col, int value) {
+        int owner = (long long)row * P / n;
+        Update u{uint32_t(row) * n + col, value};
+        if (owner == me) {
+          apply(u);
+          return;
+        }
+        staging[owner * batch + staged[owner]++] = u;
+        if (staged[owner] == batch) send(owner);
+      });
+      drainInbox();
+      left -= k;
+    }
+    for (int to = 0; to < P; to++) {
+      if (staged[to] > 0) send(to);
+    }
+
+    // Every send happened before its producer's decrement, so once the
+    // count reads zero one last drain sees them all
+    producing.fetch_sub(1, std::memory_order_acq_rel);
+    while (producing.load(std::memory_order_acquire) > 0) {
+      if (drainInbox() == 0) std::this_thread::yield();
+    }
+    drainInbox();
+  });
+}
+
+// Every thread adds straight into the shared matrix with a relaxed atomic
+// fetch_add; nothing is ordered, the sums are only read after the join
+inline void applyAtomic(FlatMatrix& matrix, long long m, int numThreads, uint64_t seed) {
+  int n = matrix.size();
+  int* cells = matrix.data();
+  runThreads(numThreads, [&](int t) {
+    UpdateGenerator updates(n, seed, t);
+    updates.generate(updatesForThread(m, numThreads, t), [&](int row, int col, int value) {
+      std::atomic_ref<int>(cells[size_t(row) * n + col]).fetch_add(value, std::memory_order_relaxed);
+    });
+  });
+}
+
+// Every thread sums its updates into a private copy of the matrix, then
+// each thread reduces one slice of cells across all copies. The copies
+// cost numThreads times the matrix, so this is for small n only.
+inline void applyPrivate(FlatMatrix& matrix, long long m, int numThreads, uint64_t seed) {
+  int n = matrix.size();
+  size_t cellCount = matrix.cellCount();
+  std::vector<std::vector<int>> partials(numThreads);
+
+  runThreads(numThreads, [&](int t) {
+    // Allocated and first touched by the thread that uses it
+    partials[t].assign(cellCount, 0);
+    int* partial = partials[t].data();
+    UpdateGenerator updates(n, seed, t);
+    updates.generate(updatesForThread(m, numThreads, t), [&](int row, int col, int value) {
+      partial[size_t(row) * n + col] += value;
+    });
+  });
+
+  int* cells = matrix.data();
+  runThreads(numThreads, [&](int t) {
+    size_t begin = cellCount * t / numThreads;
+    size_t end = cellCount * (t + 1) / numThreads;
+    for (const std::vector<int>& partial : partials) {
+      for (size_t i = begin; i < end; i++) {
+        cells[i] += partial[i];
+      }
+    }
+  });
+}
+
+inline void applyParallel(ParallelStrategy strategy, FlatMatrix& matrix, long long m,
+                          int numThreads, uint64_t seed) {
+  switch (strategy) {
+    case ParallelStrategy::RowOwner: applyRowOwner(matrix, m, numThreads, seed); break;
+    case ParallelStrategy::Atomic: applyAtomic(matrix, m, numThreads, seed); break;
+    case ParallelStrategy::Private: applyPrivate(matrix, m, numThreads, seed); break;
+  }
+}
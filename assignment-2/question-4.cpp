@@ -1,20 +1,21 @@
 #include <iostream>
+#include <algorithm>
 #include <vector>
 #include <tuple>
-#include <chrono>
-#include <random>
 #include <cstdint>
+#include <string>
+#include <thread>
+
+#include "../common/bench.h"
+#include "../common/perf_counters.h"
+#include "../common/rng.h"
+#include "update-engine.h"
+#include "parallel-updates.h"
+#include "accumulators.h"
 
 using data_item = std::tuple<int, int, int>;
 using matrix = std::vector<std::vector<int>>;
 
-// Random number generator
-int gen_random_number(int max) {
-  static std::mt19937_64 rng(std::chrono::steady_clock::now().time_since_epoch().count());
-  std::uniform_int_distribution<int> dist(0, max);
-  return dist(rng);
-}
-
 // Creates an n x n matrix initialized with zeros
 matrix create_matrix(int n) {
   return matrix(n, std::vector<int>(n, 0));
@@ -25,38 +26,351 @@ inline void apply_update(matrix& mat, int row, int col, int value) {
   mat[row][col] += value;
 }
 
+// Times m updates with the given access pattern into a fresh Acc, and
+// reports the memory it holds afterwards and its dTLB misses per update
+template <typename Acc>
+void timeAccumulator(const char* backend, int n, long long m, Access access,
+                     std::vector<bench::Result>& results) {
+  const char* accessName = access == Access::Zipf ? "zipf" : "uniform";
+  std::string name = std::string("accumulator/") + backend + "/" + accessName +
+                     "/n=" + std::to_string(n) + "/m=" + std::to_string(m);
+
+  bench::Options opts;
+  opts.iterations = 1;
+  opts.warmupSamples = 0;
+  opts.minSamples = 1;
+  opts.maxSamples = 1;
+
+  size_t bytes = 0;
+  perf::Counters counters;
+  perf::Sample sample;
+  bench::Result result;
+  try {
+    result = bench::runManual(name, [&]() {
+      Acc acc(n);
+      UpdateGenerator updates(n, rng::randomSeed(), 0, access);
+      counters.start();
+      bench::Clock::time_point start = bench::Clock::now();
+      updates.generate(m, [&](int row, int col, int value) {
+        acc.add(row, col, value);
+      });
+      bench::clobberMemory();
+      double seconds = bench::secondsSince(start);
+      sample = counters.stop().per(m);
+      bytes = acc.memoryBytes();
+      return seconds;
+    }, opts);
+  } catch (const std::length_error& e) {
+    std::cout << "n: " << n << ", m: " << m << ", " << accessName << ", " << backend
+              << ": " << e.what() << std::endl;
+    return;
+  }
+  results.push_back(result);
+
+  std::cout << "n: " << n
+            << ", m: " << m
+            << ", " << accessName
+            << ", " << backend
+            << ", Time: " << result.median << " seconds (" << m / result.median / 1e6
+            << " M updates/s)"
+            << ", Memory: " << bytes / 1048576.0 << " MiB";
+  if (sample.available(perf::DTLBMisses)) {
+    std::cout << ", dTLB misses/update: " << sample[perf::DTLBMisses];
+  }
+  std::cout << std::endl;
+}
+
+// Row-major sums of the updates numThreads threads draw from seed, each
+// applied by the direct path; every other path must reproduce them
+std::vector<int> directSums(int n, long long m, int numThreads, uint64_t seed,
+                            Access access = Access::Uniform) {
+  matrix mat = create_matrix(n);
+  for (int t = 0; t < numThreads; t++) {
+    UpdateGenerator updates(n, seed, t, access);
+    updates.generate(updatesForThread(m, numThreads, t), [&](int row, int col, int value) {
+      apply_update(mat, row, col, value);
+    });
+  }
+  std::vector<int> sums;
+  sums.reserve(size_t(n) * n);
+  for (const std::vector<int>& row : mat) sums.insert(sums.end(), row.begin(), row.end());
+  return sums;
+}
+
+bool matchesDirect(const std::string& name, const int* sums, const std::vector<int>& expected) {
+  if (std::equal(expected.begin(), expected.end(), sums)) return true;
+  std::cerr << name << " disagrees with the direct path" << std::endl;
+  return false;
+}
+
+// The batched engine on a matrix small enough to take updates directly and
+// on one large enough to partition, with a buffer that fills many times
+bool checkBatchedEngine() {
+  bool ok = true;
+  for (int n : {64, 4096}) {
+    long long m = 1 << 22;
+    uint64_t seed = rng::randomSeed();
+    FlatMatrix flat(n);
+    {
+      UpdateEngine engine(flat, 1 << 16);
+      UpdateGenerator updates(n, seed);
+      updates.generate(m, [&](int row, int col, int value) {
+        engine.add(row, col, value);
+      });
+    }
+    ok &= matchesDirect("batched/n=" + std::to_string(n), flat.data(), directSums(n, m, 1, seed));
+  }
+  return ok;
+}
+
+// Every parallel strategy, at 1, 2 and 4 threads and the hardware thread
+// count, against the direct path over the same per-thread streams. n = 1024
+// is the smallest size the sweep runs all three strategies at.
+bool checkParallelStrategies() {
+  bool ok = true;
+  int n = 1024;
+  long long m = 1 << 22;
+  int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (int threads : {1, 2, 4, maxThreads}) {
+    uint64_t seed = rng::randomSeed();
+    std::vector<int> expected = directSums(n, m, threads, seed);
+    for (ParallelStrategy strategy :
+         {ParallelStrategy::RowOwner, ParallelStrategy::Atomic, ParallelStrategy::Private}) {
+      FlatMatrix flat(n);
+      applyParallel(strategy, flat, m, threads, seed);
+      ok &= matchesDirect(std::string("parallel/") + strategyName(strategy) +
+                            "/threads=" + std::to_string(threads),
+                          flat.data(), expected);
+    }
+  }
+  return ok;
+}
+
+// The same seeded updates into Acc, read back cell by cell with get()
+template <typename Acc>
+bool accumulatorMatches(const char* backend, int n, long long m, Access access, uint64_t seed,
+                        const std::vector<int>& expected) {
+  Acc acc(n);
+  UpdateGenerator updates(n, seed, 0, access);
+  updates.generate(m, [&](int row, int col, int value) {
+    acc.add(row, col, value);
+  });
+  std::vector<int> sums(size_t(n) * n);
+  for (int row = 0; row < n; row++) {
+    for (int col = 0; col < n; col++) {
+      sums[size_t(row) * n + col] = acc.get(row, col);
+    }
+  }
+  return matchesDirect(std::string("accumulator/") + backend + "/n=" + std::to_string(n),
+                       sums.data(), expected);
+}
+
+// Every accumulator backend against the direct path, at the sweep's
+// m = n^2 / 8 and an n that leaves part-filled tiles at the edges
+bool checkAccumulators() {
+  bool ok = true;
+  int n = 300;
+  long long m = (long long)n * n / 8;
+  for (Access access : {Access::Uniform, Access::Zipf}) {
+    uint64_t seed = rng::randomSeed();
+    std::vector<int> expected = directSums(n, m, 1, seed, access);
+    ok &= accumulatorMatches<DenseAccumulator<RowMajorLayout>>("dense", n, m, access, seed, expected);
+    ok &= accumulatorMatches<HashAccumulator>("hash", n, m, access, seed, expected);
+    ok &= accumulatorMatches<TiledAccumulator>("tiled", n, m, access, seed, expected);
+  }
+  return ok;
+}
+
+// Row-major read-out of the same seeded updates in a dense matrix with
+// the given layout
+template <typename Layout>
+std::vector<int> layoutSums(int n, long long m, uint64_t seed) {
+  DenseAccumulator<Layout> acc(n);
+  UpdateGenerator updates(n, seed);
+  updates.generate(m, [&](int row, int col, int value) {
+    acc.add(row, col, value);
+  });
+  std::vector<int> sums(size_t(n) * n);
+  acc.readRowMajor(sums.data());
+  return sums;
+}
+
+// Each layout's readRowMajor against the row-major layout's, which must in
+// turn match the direct path; n = 300 pads both the tiled and Morton
+// storage past n x n
+bool checkLayouts() {
+  bool ok = true;
+  for (int n : {300, 1024}) {
+    long long m = (long long)n * n;
+    uint64_t seed = rng::randomSeed();
+    std::vector<int> rowMajor = layoutSums<RowMajorLayout>(n, m, seed);
+    std::string suffix = "/n=" + std::to_string(n);
+    ok &= matchesDirect(std::string("layout/") + RowMajorLayout::name + suffix, rowMajor.data(),
+                        directSums(n, m, 1, seed));
+    auto sameAsRowMajor = [&](const char* name, const std::vector<int>& sums) {
+      if (sums == rowMajor) return true;
+      std::cerr << "layout/" << name << suffix << " disagrees with the row-major layout" << std::endl;
+      return false;
+    };
+    ok &= sameAsRowMajor(PageTiledLayout::name, layoutSums<PageTiledLayout>(n, m, seed));
+    ok &= sameAsRowMajor(MortonLayout::name, layoutSums<MortonLayout>(n, m, seed));
+  }
+  return ok;
+}
+
+// One direct pass of m updates into a DenseMatrix with the given layout
+template <typename Layout>
+bench::Result timeLayout(const std::string& suffix, int n, long long m, uint64_t seed,
+                         const bench::Options& opts) {
+  DenseMatrix<Layout> mat(n);
+  UpdateGenerator updates(n, seed);
+  return bench::run(std::string("direct-") + Layout::name + suffix, [&]() {
+    updates.generate(m, [&](int row, int col, int value) {
+      mat(row, col) += value;
+    });
+    bench::clobberMemory();
+  }, opts);
+}
+
 int main() 
 {
   std::vector<int> n_values = {16, 64, 256, 1024, 4096, 16384};
   std::vector<long long> m_values = {1677721600LL, 13421772800LL};
+  std::vector<bench::Result> results;
+
+  // Every path is checked against the direct one before anything is timed
+  if (!checkBatchedEngine() || !checkParallelStrategies() || !checkAccumulators() ||
+      !checkLayouts()) {
+    return 1;
+  }
 
   for (size_t i = 0; i < n_values.size(); ++i) {
     for (size_t j = 0; j < m_values.size(); ++j) {
       int n = n_values[i];
       long long m = m_values[j];
 
-      matrix mat = create_matrix(n);
-
       std::cout << "Running test with n: " << n << ", and m: " << m << std::endl;
 
-      auto start = std::chrono::high_resolution_clock::now();
+      // One pass of m updates is a single sample
+      bench::Options opts;
+      opts.iterations = 1;
+      opts.warmupSamples = 0;
+      opts.minSamples = 1;
+      opts.maxSamples = 1;
 
-      for (long long t = 0; t < m; ++t) {
-        int row = gen_random_number(n - 1);
-        int col = gen_random_number(n - 1);
-        int value = gen_random_number(100); 
-        apply_update(mat, row, col, value);
+      std::string suffix = "/n=" + std::to_string(n) + "/m=" + std::to_string(m);
+      uint64_t seed = rng::randomSeed();
+      bench::Result direct;
+      {
+        matrix mat = create_matrix(n);
+        UpdateGenerator updates(n, seed);
+        direct = bench::run("direct" + suffix, [&]() {
+          updates.generate(m, [&](int row, int col, int value) {
+            apply_update(mat, row, col, value);
+          });
+          bench::clobberMemory();
+        }, opts);
       }
+      results.push_back(direct);
 
-      auto end = std::chrono::high_resolution_clock::now();
-      std::chrono::duration<double> elapsed = end - start;
+      // The same updates through the cache-blocked engine on a flat matrix;
+      // the final flush is part of the timed pass
+      bench::Result batched;
+      {
+        FlatMatrix flat(n);
+        UpdateEngine engine(flat);
+        UpdateGenerator updates(n, seed);
+        batched = bench::run("batched" + suffix, [&]() {
+          updates.generate(m, [&](int row, int col, int value) {
+            engine.add(row, col, value);
+          });
+          engine.flush();
+          bench::clobberMemory();
+        }, opts);
+      }
+      results.push_back(batched);
 
       std::cout << "n: " << n 
                 << ", m: " << m 
-                << ", Time: " << elapsed.count() << " seconds" 
+                << ", Direct: " << direct.median << " seconds (" << m / direct.median / 1e6
+                << " M updates/s)"
+                << ", Batched: " << batched.median << " seconds (" << m / batched.median / 1e6
+                << " M updates/s)"
+                << ", Speedup: " << direct.median / batched.median << "x"
                 << std::endl;
+
+      // The same direct updates into a flat matrix in each layout
+      for (const bench::Result& layout : {timeLayout<RowMajorLayout>(suffix, n, m, seed, opts),
+                                          timeLayout<PageTiledLayout>(suffix, n, m, seed, opts),
+                                          timeLayout<MortonLayout>(suffix, n, m, seed, opts)}) {
+        results.push_back(layout);
+        std::cout << "  " << layout.name << ": " << layout.median << " seconds ("
+                  << m / layout.median / 1e6 << " M updates/s)" << std::endl;
+      }
+    }
+  }
+
+  // Parallel scaling at the smaller m. Private copies only fit for small n,
+  // and routing to row owners only pays once the matrix outgrows cache.
+  int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<int> thread_counts;
+  for (int t = 1; t < maxThreads; t *= 2) thread_counts.push_back(t);
+  thread_counts.push_back(maxThreads);
+
+  long long m = m_values[0];
+  for (int n : n_values) {
+    std::vector<ParallelStrategy> strategies = {ParallelStrategy::Atomic};
+    if (n <= 1024) strategies.push_back(ParallelStrategy::Private);
+    if (n >= 1024) strategies.push_back(ParallelStrategy::RowOwner);
+
+    for (ParallelStrategy strategy : strategies) {
+      double single = 0;
+      for (int threads : thread_counts) {
+        bench::Options opts;
+        opts.iterations = 1;
+        opts.warmupSamples = 0;
+        opts.minSamples = 1;
+        opts.maxSamples = 1;
+
+        std::string name = std::string("parallel/") + strategyName(strategy) + "/n=" +
+                           std::to_string(n) + "/m=" + std::to_string(m) +
+                           "/threads=" + std::to_string(threads);
+        FlatMatrix flat(n);
+        uint64_t seed = rng::randomSeed();
+        bench::Result result = bench::run(name, [&]() {
+          applyParallel(strategy, flat, m, threads, seed);
+          bench::clobberMemory();
+        }, opts);
+        results.push_back(result);
+        if (threads == 1) single = result.median;
+
+        std::cout << "n: " << n
+                  << ", m: " << m
+                  << ", " << strategyName(strategy)
+                  << ", threads: " << threads
+                  << ", Time: " << result.median << " seconds (" << m / result.median / 1e6
+                  << " M updates/s)"
+                  << ", Scaling: " << single / result.median << "x"
+                  << std::endl;
+      }
+    }
+  }
+
+  // Accumulator backends under uniform and skewed access, with the dense
+  // matrix in each layout. The sweeps above touch every cell, which no
+  // sparse store survives, so these runs take at most n^2 / 8 updates and
+  // 2e7 at most, leaving most cells untouched at every n.
+  for (int n : n_values) {
+    long long m = std::min<long long>(20000000, (long long)n * n / 8);
+    for (Access access : {Access::Uniform, Access::Zipf}) {
+      timeAccumulator<DenseAccumulator<RowMajorLayout>>("dense", n, m, access, results);
+      timeAccumulator<DenseAccumulator<PageTiledLayout>>("dense-page-tiled", n, m, access, results);
+      timeAccumulator<DenseAccumulator<MortonLayout>>("dense-morton", n, m, access, results);
+      timeAccumulator<HashAccumulator>("hash", n, m, access, results);
+      timeAccumulator<TiledAccumulator>("tiled", n, m, access, results);
     }
   }
 
+  bench::writeReports(results);
   return 0;
 }
@@ -4,96 +4,516 @@
 #include <chrono>
 #include <random>
 #include <algorithm>
-#include <sys/resource.h>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
+#include "../common/bench.h"
+#include "../common/perf_counters.h"
+#include "../common/resource_sampler.h"
+
+// Regular pins the mapping to base pages even where THP is on by default;
+// Transparent asks for THP with madvise; Explicit maps from the hugetlbfs
+// pool, which needs pages reserved in /proc/sys/vm/nr_hugepages
+enum class Backing { Regular, Transparent, Explicit };
+const char* backing_name(Backing b) {
+  switch (b) {
+    case Backing::Regular: return "regular";
+    case Backing::Transparent: return "thp";
+    case Backing::Explicit: return "hugetlb";
+  }
+  return "?";
+}
+
+// Order in which each thread visits the base pages of its slice: in order,
+// shuffled, or `stride` pages apart in stride passes
+enum class Pattern { Sequential, Shuffled, Strided };
+const char* pattern_name(Pattern p) {
+  switch (p) {
+    case Pattern::Sequential: return "sequential";
+    case Pattern::Shuffled: return "shuffled";
+    case Pattern::Strided: return "strided";
+  }
+  return "?";
+}
+
+// How the file-backed mode pages its mapping in: no hint, one of the
+// madvise hints, or MADV_RANDOM (no kernel readahead) plus userspace
+// prefetch threads that request each page with its own MADV_WILLNEED ahead
+// of the worker, which starts the read without waiting for it
+enum class FileHint { None, Sequential, Random, WillNeed, Prefetch };
+const char* hint_name(FileHint h) {
+  switch (h) {
+    case FileHint::None: return "none";
+    case FileHint::Sequential: return "sequential";
+    case FileHint::Random: return "random";
+    case FileHint::WillNeed: return "willneed";
+    case FileHint::Prefetch: return "prefetch";
+  }
+  return "?";
+}
+
+const size_t huge_page_size = 2 * 1024 * 1024;
+const size_t stride_pages = 64;
+const int prefetch_threads = 4;
+const size_t prefetch_window_pages = 16384;  // 64 MiB ahead of the worker
+
 struct Metrics {
-  double elapsed_s;
-  size_t rss_kb;
-  long page_faults;
+  double elapsed_s = 0;
+  long peak_rss_kb = 0;    // highest sampled during the timed run
+  long peak_swap_kb = 0;
+  long touch_faults = 0;   // minor + major while first touching the buffer
+  long minor_faults = 0;   // during the timed run
+  long major_faults = 0;
+  double touches = 0;
+  perf::Sample counters{};
 };
 
-Metrics get_process_metrics(double elapseds_s) {
-  struct rusage usage{};
-  getrusage(RUSAGE_SELF, &usage);
+// The row logged for a run that threw: elapsed -1, everything else zero
+Metrics failed_metrics() {
+  Metrics m;
+  m.elapsed_s = -1;
+  return m;
+}
 
-  std::ifstream statm("/proc/self/statm");
-  size_t size, resident;
-  statm >> size >> resident;
+// Anonymous mapping with the requested page backing
+class Buffer {
+public:
+  Buffer(size_t bytes, Backing backing) : size(bytes) {
+    if (backing == Backing::Explicit) {
+      mapped_size = (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+      void* p = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p == MAP_FAILED) throw std::runtime_error("MAP_HUGETLB failed (no huge pages reserved?)");
+      base = static_cast<char*>(p);
+      data = base;
+      return;
+    }
+
+    // Over-map by one huge page so the data can start on a 2 MiB boundary,
+    // which THP needs to back it with huge pages from the first byte
+    mapped_size = bytes + huge_page_size;
+    void* p = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) throw std::bad_alloc();
+    base = static_cast<char*>(p);
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(base) + huge_page_size - 1) &
+                        ~(uintptr_t)(huge_page_size - 1);
+    data = reinterpret_cast<char*>(aligned);
+    madvise(data, bytes, backing == Backing::Transparent ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+  }
+
+  ~Buffer() { munmap(base, mapped_size); }
+
+  Buffer(const Buffer&) = delete;
+  Buffer& operator=(const Buffer&) = delete;
+
+  char* data;
+  size_t size;
+
+private:
+  char* base;
+  size_t mapped_size;
+};
+
+// CPUs the process may run on, in order; read once, before any pinning
+const std::vector<int>& allowed_cpus() {
+  static const std::vector<int> cpus = []() {
+    std::vector<int> list;
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) list.push_back(cpu);
+      }
+    }
+    if (list.empty()) list.push_back(0);
+    return list;
+  }();
+  return cpus;
+}
 
+// Runs f(t) on num_threads threads, thread t pinned to the (t mod count)-th
+// CPU the process is allowed on, so pinning holds under a cpuset or
+// taskset. Pinning the same t to the same CPU in every phase keeps each
+// thread on the NUMA node where it first touched its slice.
+template <typename F>
+void run_pinned(int num_threads, F f) {
+  const std::vector<int>& cpus = allowed_cpus();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < num_threads; ++t) {
+    workers.emplace_back([&, t]() {
+      bench::CpuPin pin(cpus[t % cpus.size()]);
+      f(t);
+    });
+  }
+  for (auto& w : workers) w.join();
+}
+
+// Base pages of slice [first, first + count) in the order the pattern
+// visits them
+std::vector<size_t> page_order(size_t first, size_t count, Pattern pattern, uint64_t seed) {
+  std::vector<size_t> order;
+  order.reserve(count);
+  if (pattern == Pattern::Strided) {
+    for (size_t start = 0; start < std::min(stride_pages, count); ++start) {
+      for (size_t p = start; p < count; p += stride_pages) order.push_back(first + p);
+    }
+  } else {
+    for (size_t p = 0; p < count; ++p) order.push_back(first + p);
+    if (pattern == Pattern::Shuffled) {
+      std::mt19937_64 rng(seed);
+      std::shuffle(order.begin(), order.end(), rng);
+    }
+  }
+  return order;
+}
+
+// Splits the buffer's base pages into one contiguous slice per thread.
+// Each thread first touches its own slice, so the kernel places it on that
+// thread's node, then touches one byte per page in the pattern's order,
+// touches_per_page times per iteration. The first touch and the timed run
+// are separate sampler phases named after label, so neither sees the
+// other's faults.
+Metrics run_workload(size_t data_size_bytes, Backing backing, Pattern pattern,
+                     int num_threads, int iterations, resources::Sampler& sampler,
+                     const std::string& label) {
   long page_size = sysconf(_SC_PAGESIZE);
+  size_t num_pages = data_size_bytes / page_size;
+  Buffer buffer(num_pages * page_size, backing);
+  char* data = buffer.data;
+
+  auto slice_begin = [&](int t) { return num_pages * t / num_threads; };
+
+  std::vector<std::vector<size_t>> orders(num_threads);
+  sampler.begin(label + "/touch");
+  run_pinned(num_threads, [&](int t) {
+    size_t first = slice_begin(t), count = slice_begin(t + 1) - first;
+    std::fill(data + first * page_size, data + (first + count) * page_size, 1);
+    orders[t] = page_order(first, count, pattern, 42 + t);
+  });
+  resources::Phase touch_phase = sampler.end();
+
+  const int touches_per_page = 500;
+
+  sampler.begin(label + "/run");
+  perf::Counters counters;
+  counters.start();
+  auto start = std::chrono::high_resolution_clock::now();
+
+  run_pinned(num_threads, [&](int t) {
+    unsigned long long sink = 0;
+    const std::vector<size_t>& order = orders[t];
+    for (int it = 0; it < iterations; ++it) {
+      for (int touch = 0; touch < touches_per_page; ++touch) {
+        for (size_t page : order) {
+          size_t offset = page * page_size;
+          data[offset] += 1;
+          sink += data[offset];
+        }
+      }
+    }
+    bench::doNotOptimize(sink);
+  });
+
+  auto end = std::chrono::high_resolution_clock::now();
+  perf::Sample sample = counters.stop();
+  resources::Phase run_phase = sampler.end();
+
   Metrics m{};
-  m.elapsed_s = elapsed_s;
-  m.rss_kb = resident * page_size / 1024;
-  m.page_faults = usage.ru_majflt + usage.ru_minflt;
+  m.elapsed_s = std::chrono::duration<double>(end - start).count();
+  m.peak_rss_kb = run_phase.peakRssKb;
+  m.peak_swap_kb = run_phase.peakSwapKb;
+  m.touch_faults = touch_phase.minorFaults + touch_phase.majorFaults;
+  m.minor_faults = run_phase.minorFaults;
+  m.major_faults = run_phase.majorFaults;
+  m.touches = (double)num_pages * touches_per_page * iterations;
+  m.counters = sample;
   return m;
 }
 
-Metrics run_workload(size_t data_size_bytes, bool random_access, int iterations) {
+// Scratch file of the given size, filled with data so every page exists
+// on disk. The name is unlinked as soon as the file is open, so it goes
+// away with the process however the process ends.
+class ScratchFile {
+public:
+  ScratchFile(const std::string& path, size_t bytes) : size(bytes) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) throw std::runtime_error("Cannot create " + path);
+    unlink(path.c_str());
+
+    std::vector<char> chunk(1 << 20, 1);
+    for (size_t written = 0; written < bytes;) {
+      size_t n = std::min(chunk.size(), bytes - written);
+      ssize_t w = write(fd, chunk.data(), n);
+      if (w <= 0) {
+        close(fd);
+        throw std::runtime_error("Cannot fill scratch file (disk full?)");
+      }
+      written += w;
+    }
+    fdatasync(fd);
+  }
+
+  ~ScratchFile() { close(fd); }
+
+  ScratchFile(const ScratchFile&) = delete;
+  ScratchFile& operator=(const ScratchFile&) = delete;
+
+  // Evicts the file's clean pages, so the next run starts cold
+  void drop_cache() { posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED); }
+
+  int fd;
+  size_t size;
+};
+
+// Read-only shared mapping of the whole scratch file
+class FileMapping {
+public:
+  explicit FileMapping(const ScratchFile& file) : size(file.size) {
+    void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, file.fd, 0);
+    if (p == MAP_FAILED) throw std::runtime_error("Cannot map scratch file");
+    data = static_cast<char*>(p);
+  }
+
+  ~FileMapping() { munmap(data, size); }
+
+  FileMapping(const FileMapping&) = delete;
+  FileMapping& operator=(const FileMapping&) = delete;
+
+  char* data;
+  size_t size;
+};
+
+// Threads that wait for go before starting and give up once done is set.
+// stop() sets both and joins whatever was started, and the destructor calls
+// it, so a throw part way through starting them leaves none joinable.
+struct PrefetchThreads {
+  std::atomic<bool> go{false}, done{false};
+  std::vector<std::thread> threads;
+
+  ~PrefetchThreads() { stop(); }
+
+  void stop() {
+    done.store(true);
+    go.store(true, std::memory_order_release);
+    for (auto& t : threads) t.join();
+    threads.clear();
+  }
+};
+
+// Maps the scratch file from a cold page cache and reads one byte of every
+// page once per iteration in the pattern's order, on one worker thread.
+// Reads keep the pages clean, so the kernel can drop them without writeback
+// once the file outgrows memory. The timed loop is one sampler phase.
+Metrics run_file_workload(ScratchFile& file, Pattern pattern, FileHint hint, int iterations,
+                          resources::Sampler& sampler, const std::string& label) {
   long page_size = sysconf(_SC_PAGESIZE);
-  size_t num_pages = data_size_bytes / page_size;
+  size_t num_pages = file.size / page_size;
+  std::vector<size_t> order = page_order(0, num_pages, pattern, 42);
 
-  std::vector<char> data(data_size_bytes, 1);
-  std::vector<size_t> page_indices(num_pages);
-  for (size_t i = 0; i < num_pages; ++i) page_indices[i] = i;
+  file.drop_cache();
+  FileMapping mapping(file);
+  char* p = mapping.data;
+  const char* data = mapping.data;
 
-  if (random_access) {
-    std::mt19937 rng(42);
-    std::shuffle(page_indices.begin(), page_indices.end(), rng);
+  switch (hint) {
+    case FileHint::None: break;
+    case FileHint::Sequential: madvise(p, file.size, MADV_SEQUENTIAL); break;
+    case FileHint::Random:
+    case FileHint::Prefetch: madvise(p, file.size, MADV_RANDOM); break;
+    case FileHint::WillNeed: madvise(p, file.size, MADV_WILLNEED); break;
   }
 
-  const int touches_per_page = 500;
+  // The worker publishes how far it has got; prefetcher k requests every
+  // prefetch_threads-th page, stays within the window ahead of the worker
+  // and skips whatever the worker has already passed. The prefetchers are
+  // started before the clock and wait for go, so their spawn is not timed.
+  std::atomic<size_t> progress(0);
+  PrefetchThreads prefetchers;
+  std::atomic<bool>& done = prefetchers.done;
+  if (hint == FileHint::Prefetch) {
+    for (int k = 0; k < prefetch_threads; ++k) {
+      prefetchers.threads.emplace_back([&, k]() {
+        while (!prefetchers.go.load(std::memory_order_acquire)) std::this_thread::yield();
+        for (int it = 0; it < iterations && !done.load(std::memory_order_relaxed); ++it) {
+          size_t base = (size_t)it * num_pages;
+          for (size_t i = k; i < num_pages; i += prefetch_threads) {
+            size_t at;
+            while (base + i > (at = progress.load(std::memory_order_relaxed)) + prefetch_window_pages) {
+              if (done.load(std::memory_order_relaxed)) return;
+              std::this_thread::yield();
+            }
+            if (base + i < at) continue;
+            madvise(p + order[i] * page_size, page_size, MADV_WILLNEED);
+          }
+        }
+      });
+    }
+  }
 
-  volatile unsigned long long sink = 0;
+  sampler.begin(label);
   auto start = std::chrono::high_resolution_clock::now();
+  prefetchers.go.store(true, std::memory_order_release);
 
+  unsigned long long sink = 0;
   for (int it = 0; it < iterations; ++it) {
-    for (int t = 0; t < touches_per_page; ++t) {
-      for (size_t p = 0; p < num_pages; ++p) {
-        size_t offset = page_indices[p] * page_size;
-        data[offset] += 1;
-        sink += data[offset];
-      }
+    for (size_t i = 0; i < num_pages; ++i) {
+      sink += data[order[i] * page_size];
+      if (i % 64 == 0) progress.store((size_t)it * num_pages + i, std::memory_order_relaxed);
     }
   }
+  bench::doNotOptimize(sink);
+  prefetchers.stop();
 
   auto end = std::chrono::high_resolution_clock::now();
-  double elapsed = std::chrono::duration<double>(end - start).count();
-  return get_process_metrics(elapsed);
+  resources::Phase phase = sampler.end();
+
+  Metrics m{};
+  m.elapsed_s = std::chrono::duration<double>(end - start).count();
+  m.peak_rss_kb = phase.peakRssKb;
+  m.peak_swap_kb = phase.peakSwapKb;
+  m.minor_faults = phase.minorFaults;
+  m.major_faults = phase.majorFaults;
+  m.touches = (double)num_pages * iterations;
+  return m;
+}
+
+// The ratio as the CSVs print it, for phase labels
+std::string ratio_name(double ratio) {
+  std::ostringstream out;
+  out << ratio;
+  return out.str();
+}
+
+void log_file_results(std::ofstream& out, double ratio, double size_gb, Pattern pattern,
+                      FileHint hint, const Metrics& m) {
+  double gb_per_s = m.elapsed_s > 0 ? m.touches * sysconf(_SC_PAGESIZE) / m.elapsed_s / 1e9 : -1;
+  out << ratio << "," << size_gb << "," << pattern_name(pattern) << "," << hint_name(hint) << ","
+      << m.elapsed_s << "," << gb_per_s << "," << m.peak_rss_kb << "," << m.peak_swap_kb << ","
+      << m.minor_faults << "," << m.major_faults << "\n";
+  out.flush();
 }
 
-void log_results(std::ofstream& out, double ratio, double size_gb,
-                 const Metrics& seq, const Metrics& rnd) {
-  out << ratio << "," << size_gb << ","
-      << seq.elapsed_s << "," << seq.rss_kb << "," << seq.page_faults << ","
-      << rnd.elapsed_s << "," << rnd.rss_kb << "," << rnd.page_faults << "\n";
+void log_results(std::ofstream& out, double ratio, double size_gb, int threads,
+                 Backing backing, Pattern pattern, const Metrics& m) {
+  double dtlb_per_touch = m.counters.available(perf::DTLBMisses) && m.touches > 0
+                            ? m.counters[perf::DTLBMisses] / m.touches : -1;
+  out << ratio << "," << size_gb << "," << threads << ","
+      << backing_name(backing) << "," << pattern_name(pattern) << ","
+      << m.elapsed_s << "," << m.peak_rss_kb << "," << m.peak_swap_kb << ","
+      << m.touch_faults << "," << m.minor_faults << "," << m.major_faults << ","
+      << dtlb_per_touch << "," << perf::csvValues(m.counters) << "\n";
   out.flush();
 }
 
-int main() 
+int main()
 {
-  const double M_bytes = 8.0 * 1024 * 1024 * 1024; 
+  const double M_bytes = 8.0 * 1024 * 1024 * 1024;
   std::vector<double> ratios = {0.5, 0.6, 0.7, 0.8, 0.9, 0.95, 0.99, 1.0, 1.01, 1.1, 1.5, 2.0};
   int iterations = 1;
 
+  int max_threads = allowed_cpus().size();
+  std::vector<int> thread_counts;
+  for (int t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+  thread_counts.push_back(max_threads);
+
+  const Backing backings[] = {Backing::Regular, Backing::Transparent, Backing::Explicit};
+  const Pattern patterns[] = {Pattern::Sequential, Pattern::Shuffled, Pattern::Strided};
+
+  // Samples RSS, swap and faults every 10 ms for the whole sweep; each
+  // ratio's samples are appended to memory_scaling_timeseries.csv once it
+  // finishes, so a run killed part way keeps what it had
+  resources::Sampler sampler;
+  std::ofstream series("memory_scaling_timeseries.csv");
+
   std::ofstream out("memory_scaling_results.csv");
-  out << "C/M,Data_Size_GB,Seq_Time_s,Seq_RSS_KB,Seq_PageFaults,"
-          "Rand_Time_s,Rand_RSS_KB,Rand_PageFaults\n";
+  out << "C/M,Data_Size_GB,Threads,Backing,Pattern,Time_s,Peak_RSS_KB,Peak_Swap_KB,"
+         "Touch_PageFaults,Minor_PageFaults,Major_PageFaults,DTLB_Misses_per_Touch,"
+      << perf::csvHeader("") << "\n";
 
   for (double ratio : ratios) {
     double data_size_bytes = M_bytes * ratio;
     double data_size_gb = data_size_bytes / (1024.0 * 1024.0 * 1024.0);
     std::cout << "C/M = " << ratio << " (" << data_size_gb << " GB)\n";
 
+    for (int threads : thread_counts) {
+      for (Backing backing : backings) {
+        for (Pattern pattern : patterns) {
+          std::cout << "  threads = " << threads << ", " << backing_name(backing)
+                    << ", " << pattern_name(pattern) << std::endl;
+          try {
+            std::string label = "C/M=" + ratio_name(ratio) + "/" + std::to_string(threads) + "T/" +
+                                backing_name(backing) + "/" + pattern_name(pattern);
+            Metrics m = run_workload((size_t)data_size_bytes, backing, pattern, threads, iterations,
+                                     sampler, label);
+            log_results(out, ratio, data_size_gb, threads, backing, pattern, m);
+          } catch (const std::bad_alloc&) {
+            std::cerr << "Memory allocation failed at C/M = " << ratio << "\n";
+            log_results(out, ratio, data_size_gb, threads, backing, pattern, failed_metrics());
+          } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << " at C/M = " << ratio << "\n";
+            log_results(out, ratio, data_size_gb, threads, backing, pattern, failed_metrics());
+          }
+        }
+      }
+    }
+    sampler.writeCsv(series);
+  }
+
+  // File-backed mode: the same sizes as a scratch file in the working
+  // directory, which needs that much free disk, paged in by the kernel
+  // under each hint or by the prefetch threads
+  const Pattern file_patterns[] = {Pattern::Sequential, Pattern::Shuffled};
+  const FileHint hints[] = {FileHint::None, FileHint::Sequential, FileHint::Random,
+                            FileHint::WillNeed, FileHint::Prefetch};
+
+  std::ofstream file_out("memory_scaling_file_results.csv");
+  file_out << "C/M,Data_Size_GB,Pattern,Hint,Time_s,Throughput_GB_per_s,Peak_RSS_KB,"
+              "Peak_Swap_KB,Minor_PageFaults,Major_PageFaults\n";
+
+  for (double ratio : ratios) {
+    double data_size_bytes = M_bytes * ratio;
+    double data_size_gb = data_size_bytes / (1024.0 * 1024.0 * 1024.0);
+    std::cout << "File-backed C/M = " << ratio << " (" << data_size_gb << " GB)\n";
+
+    std::unique_ptr<ScratchFile> file;
     try {
-      Metrics seq = run_workload((size_t)data_size_bytes, false, iterations);
-      Metrics rnd = run_workload((size_t)data_size_bytes, true, iterations);
-      log_results(out, ratio, data_size_gb, seq, rnd);
-    } catch (const std::bad_alloc&) {
-      std::cerr << "Memory allocation failed at C/M = " << ratio << "\n";
-      Metrics empty = {-1, 0, 0};
-      log_results(out, ratio, data_size_gb, empty, empty);
+      file = std::make_unique<ScratchFile>("question-6-scratch.bin", (size_t)data_size_bytes);
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << " at C/M = " << ratio << "\n";
+      for (Pattern pattern : file_patterns) {
+        for (FileHint hint : hints) {
+          log_file_results(file_out, ratio, data_size_gb, pattern, hint, failed_metrics());
+        }
+      }
+      continue;
+    }
+
+    for (Pattern pattern : file_patterns) {
+      for (FileHint hint : hints) {
+        std::cout << "  " << pattern_name(pattern) << ", " << hint_name(hint) << std::endl;
+        std::string label = "file/C/M=" + ratio_name(ratio) + "/" + pattern_name(pattern) + "/" +
+                            hint_name(hint);
+        try {
+          Metrics m = run_file_workload(*file, pattern, hint, iterations, sampler, label);
+          log_file_results(file_out, ratio, data_size_gb, pattern, hint, m);
+        } catch (const std::bad_alloc&) {
+          std::cerr << "Memory allocation failed at C/M = " << ratio << "\n";
+          log_file_results(file_out, ratio, data_size_gb, pattern, hint, failed_metrics());
+        } catch (const std::runtime_error& e) {
+          std::cerr << e.what() << " at C/M = " << ratio << "\n";
+          log_file_results(file_out, ratio, data_size_gb, pattern, hint, failed_metrics());
+        }
+      }
     }
+    sampler.writeCsv(series);
   }
 
   return 0;
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "../common/rng.h"
+#include "dense-matrix.h"
+
+struct Update {
+  uint32_t cell;  // row * n + col
+  int32_t value;
+};
+
+enum class Access { Uniform, Zipf };
+
+// Random updates (row, col, value) with row and col in [0, n) and value in
+// [0, maxValue], drawn a chunk at a time so the generator runs in batches.
+// Zipf access draws cell ranks with P(rank r) ~ 1 / r by inverting the
+// continuous CDF, then scatters ranks over the matrix so the hot cells are
+// not all in the first rows.
+class UpdateGenerator {
+public:
+  static constexpr int chunk = 1024;
+  static constexpr int maxValue = 100;
+
+  UpdateGenerator(int n, uint64_t seed, uint64_t stream = 0, Access access = Access::Uniform)
+    : n(n), access(access), rng(seed, stream),
+      cellCount(uint64_t(n) * n), logCells(std::log(double(cellCount))) {}
+
+  // Calls f(row, col, value) for each of count updates
+  template <typename F>
+  void generate(long long count, F f) {
+    while (count > 0) {
+      int k = std::min<long long>(count, chunk);
+      if (access == Access::Zipf) {
+        rng.fillUnit(units, k);
+        for (int i = 0; i < k; i++) {
+          uint64_t rank = std::min<uint64_t>(std::exp(units[i] * logCells), cellCount) - 1;
+          uint64_t cell = rank * 2654435761 % cellCount;
+          rows[i] = cell / n;
+          cols[i] = cell % n;
+        }
+      } else {
+        rng.fillUniform(rows, k, 0, n - 1);
+        rng.fillUniform(cols, k, 0, n - 1);
+      }
+      rng.fillUniform(values, k, 0, maxValue);
+      for (int i = 0; i < k; i++) {
+        f(rows[i], cols[i], values[i]);
+      }
+      count -= k;
+    }
+  }
+
+private:
+  int n;
+  Access access;
+  rng::Generator rng;
+  uint64_t cellCount;
+  double logCells;
+  int rows[chunk], cols[chunk], values[chunk];
+  double units[chunk];
+};
+
+// Applies updates to a FlatMatrix a buffer at a time instead of one by one.
+//
+// A full buffer is radix-partitioned on the high bits of the cell index, at
+// most radixBits per pass, until every partition falls inside one tile of
+// 2^tileBits consecutive cells (a block of whole or part rows). Each
+// partition is then applied while its tile sits in L2, so the random
+// accesses hit cache and a handful of pages rather than the whole matrix.
+// The first pass's bucket sizes are counted as updates arrive, which saves
+// a read of the buffer. A matrix of up to 2^directBits cells fits in the
+// last-level cache already, and takes updates directly.
+//
+// Updates are only guaranteed to be in the matrix after flush(), which the
+// destructor also calls.
+class UpdateEngine {
+public:
+  static constexpr int tileBits = 16;    // 256 KiB of ints
+  static constexpr int radixBits = 12;   // 4096 buckets, one pass up to n = 16384
+  static constexpr int directBits = 22;  // 16 MiB of ints
+  // Partitions this small are applied as they are, since another pass
+  // would cost more than the misses it saves
+  static constexpr size_t minPartition = 64;
+
+  // The buffer defaults to one update per 8 cells, so a tile sees enough
+  // updates per flush to reuse its cache lines, capped at 2^24 updates
+  explicit UpdateEngine(FlatMatrix& matrix, size_t bufferUpdates = 0)
+    : cells(matrix.data()), n(matrix.size()),
+      cellBits(std::bit_width(std::max<size_t>(matrix.cellCount(), 1) - 1)) {
+    if (n > 65535) throw std::invalid_argument("Matrix too large for 32-bit cell indices");
+    direct = cellBits <= directBits;
+    if (bufferUpdates == 0) {
+      bufferUpdates = std::clamp<size_t>(matrix.cellCount() / 8, 1 << 16, 1 << 24);
+    }
+    if (!direct) {
+      buffer.resize(bufferUpdates);
+      scratch.resize(bufferUpdates);
+      topShift = cellBits - std::min(radixBits, cellBits - tileBits);
+      topCounts.resize(size_t(1) << (cellBits - topShift));
+    }
+  }
+
+  ~UpdateEngine() { flush(); }
+
+  UpdateEngine(const UpdateEngine&) = delete;
+  UpdateEngine& operator=(const UpdateEngine&) = delete;
+
+  void add(int row, int col, int value) {
+    uint32_t cell = uint32_t(row) * n + col;
+    if (direct) {
+      cells[cell] += value;
+      return;
+    }
+    topCounts[cell >> topShift]++;
+    buffer[pending++] = {cell, value};
+    if (pending == buffer.size()) flush();
+  }
+
+  void flush() {
+    if (pending == 0) return;
+    partitionAndApply(buffer.data(), scratch.data(), pending, cellBits, topCounts.data());
+    std::fill(topCounts.begin(), topCounts.end(), 0);
+    pending = 0;
+  }
+
+private:
+  // Applies the count updates at data, whose cells agree on every bit from
+  // `bits` up, using scratch (also count long) for the partition pass.
+  // counts, if given, already holds the bucket sizes of this pass.
+  void partitionAndApply(Update* data, Update* scratch, size_t count, int bits,
+                         const size_t* counts = nullptr) {
+    if (bits <= tileBits || count < minPartition) {
+      for (size_t i = 0; i < count; i++) {
+        cells[data[i].cell] += data[i].value;
+      }
+      return;
+    }
+
+    int digitBits = std::min(radixBits, bits - tileBits);
+    int shift = bits - digitBits;
+    uint32_t mask = (1u << digitBits) - 1;
+
+    size_t offsets[1 << radixBits] = {};
+    if (counts) {
+      std::copy_n(counts, mask + 1, offsets);
+    } else {
+      for (size_t i = 0; i < count; i++) {
+        offsets[(data[i].cell >> shift) & mask]++;
+      }
+    }
+    size_t sum = 0;
+    for (uint32_t d = 0; d <= mask; d++) {
+      size_t bucket = offsets[d];
+      offsets[d] = sum;
+      sum += bucket;
+    }
+    for (size_t i = 0; i < count; i++) {
+      scratch[offsets[(data[i].cell >> shift) & mask]++] = data[i];
+    }
+
+    // offsets[d] now ends bucket d; the buckets swap into data as scratch
+    size_t begin = 0;
+    for (uint32_t d = 0; d <= mask; d++) {
+      partitionAndApply(scratch + begin, data + begin, offsets[d] - begin, shift);
+      begin = offsets[d];
+    }
+  }
+
+  int* cells;
+  int n;
+  int cellBits;
+  bool direct;
+  std::vector<Update> buffer, scratch;
+  // Bucket sizes of the first partition pass, counted as updates arrive
+  int topShift = 0;
+  std::vector<size_t> topCounts;
+  size_t pending = 0;
+};
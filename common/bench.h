@@ -0,0 +1,265 @@
+#pragma once
+
+// Header-only micro-benchmark harness shared by every benchmark in the repo.
+//
+//   bench::Result r = bench::run("addRowMajor/n=1024", [&]() {
+//     addRowMajor(A, B, C);
+//     bench::clobberMemory();
+//   });
+//
+// Iterations per sample are calibrated until a sample takes at least
+// minSampleSeconds, samples outside Tukey fences are dropped, and the
+// result reports the median, p90 and p99 time per iteration with 95%
+// order-statistic confidence intervals. bench::writeReports() saves all
+// results as CSV and/or JSON when BENCH_CSV / BENCH_JSON name output files.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace bench {
+
+// Forces value to be computed and kept, without any runtime cost
+template <typename T>
+inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void* sink;
+  sink = &value;
+#endif
+}
+
+// Forces pending writes to memory to be treated as observable
+inline void clobberMemory() {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : : "memory");
+#endif
+}
+
+struct Options {
+  int minSamples = 10;
+  int maxSamples = 1000;
+  double minSampleSeconds = 0.005;  // calibration target per sample
+  double maxSeconds = 1.0;          // stop once minSamples are in and this passes
+  long long iterations = 0;         // iterations per sample, 0 to calibrate
+  int warmupSamples = 1;
+  double outlierFence = 3.0;        // Tukey fence in IQRs, 0 keeps everything
+  int pinCpu = -1;                  // CPU to pin the calling thread to, -1 for none
+};
+
+// All times are seconds per iteration
+struct Result {
+  std::string name;
+  long long iterations = 0;  // per sample
+  int samples = 0;           // kept after outlier rejection
+  int rejected = 0;
+  double mean = 0, stddev = 0, min = 0, max = 0;
+  double median = 0, medianLow = 0, medianHigh = 0;
+  double p90 = 0, p90Low = 0, p90High = 0;
+  double p99 = 0, p99Low = 0, p99High = 0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+inline double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Linearly interpolated quantile of sorted values
+inline double quantile(const std::vector<double>& sorted, double q) {
+  if (sorted.empty()) return 0.0;
+  double pos = q * (sorted.size() - 1);
+  size_t lo = (size_t)pos;
+  size_t hi = std::min(lo + 1, sorted.size() - 1);
+  return sorted[lo] + (pos - lo) * (sorted[hi] - sorted[lo]);
+}
+
+// Distribution-free 95% interval for quantile q: the order statistics
+// whose ranks bracket N*q by 1.96 binomial standard deviations
+inline void quantileInterval(const std::vector<double>& sorted, double q,
+                             double& low, double& high) {
+  double n = sorted.size();
+  double half = 1.96 * std::sqrt(n * q * (1 - q));
+  long long lo = (long long)std::floor(n * q - half);
+  long long hi = (long long)std::ceil(n * q + half);
+  low = sorted[std::clamp<long long>(lo, 0, n - 1)];
+  high = sorted[std::clamp<long long>(hi, 0, n - 1)];
+}
+
+inline Result summarize(const std::string& name, long long iterations,
+                        std::vector<double> samples, double outlierFence) {
+  Result r;
+  r.name = name;
+  r.iterations = iterations;
+  std::sort(samples.begin(), samples.end());
+
+  if (outlierFence > 0 && samples.size() >= 4) {
+    double q1 = quantile(samples, 0.25), q3 = quantile(samples, 0.75);
+    double lowFence = q1 - outlierFence * (q3 - q1);
+    double highFence = q3 + outlierFence * (q3 - q1);
+    size_t before = samples.size();
+    samples.erase(std::remove_if(samples.begin(), samples.end(), [&](double s) {
+      return s < lowFence || s > highFence;
+    }), samples.end());
+    r.rejected = before - samples.size();
+  }
+
+  r.samples = samples.size();
+  if (samples.empty()) return r;
+
+  double sum = 0, sumSquares = 0;
+  for (double s : samples) {
+    sum += s;
+    sumSquares += s * s;
+  }
+  r.mean = sum / samples.size();
+  r.stddev = std::sqrt(std::max(0.0, sumSquares / samples.size() - r.mean * r.mean));
+  r.min = samples.front();
+  r.max = samples.back();
+  r.median = quantile(samples, 0.5);
+  r.p90 = quantile(samples, 0.9);
+  r.p99 = quantile(samples, 0.99);
+  quantileInterval(samples, 0.5, r.medianLow, r.medianHigh);
+  quantileInterval(samples, 0.9, r.p90Low, r.p90High);
+  quantileInterval(samples, 0.99, r.p99Low, r.p99High);
+  return r;
+}
+
+// Pins the calling thread for the lifetime of the object
+class CpuPin {
+public:
+  CpuPin(int cpu) {
+#ifdef __linux__
+    if (cpu < 0) return;
+    pinned = sched_getaffinity(0, sizeof(previous), &previous) == 0;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pinned = pinned && sched_setaffinity(0, sizeof(set), &set) == 0;
+#endif
+  }
+
+  ~CpuPin() {
+#ifdef __linux__
+    if (pinned) sched_setaffinity(0, sizeof(previous), &previous);
+#endif
+  }
+
+private:
+#ifdef __linux__
+  cpu_set_t previous;
+#endif
+  bool pinned = false;
+};
+
+// Core loop: sample(iterations) runs that many iterations and returns the
+// seconds they took
+template <typename Sampler>
+Result measure(const std::string& name, Sampler sample, const Options& opts) {
+  CpuPin pin(opts.pinCpu);
+
+  long long iterations = opts.iterations;
+  if (iterations <= 0) {
+    iterations = 1;
+    while (true) {
+      double elapsed = sample(iterations);
+      if (elapsed >= opts.minSampleSeconds || iterations >= (1LL << 40)) break;
+      double scale = elapsed > 0 ? 1.2 * opts.minSampleSeconds / elapsed : 10.0;
+      iterations = (long long)std::ceil(iterations * std::clamp(scale, 2.0, 10.0));
+    }
+  }
+
+  for (int i = 0; i < opts.warmupSamples; i++) {
+    sample(iterations);
+  }
+
+  std::vector<double> samples;
+  Clock::time_point start = Clock::now();
+  while ((int)samples.size() < opts.maxSamples) {
+    samples.push_back(sample(iterations) / iterations);
+    if ((int)samples.size() >= opts.minSamples && secondsSince(start) >= opts.maxSeconds) {
+      break;
+    }
+  }
+
+  return summarize(name, iterations, samples, opts.outlierFence);
+}
+
+// Times f(), which should feed its results to doNotOptimize/clobberMemory
+template <typename F>
+Result run(const std::string& name, F&& f, const Options& opts = Options()) {
+  return measure(name, [&](long long iterations) {
+    Clock::time_point start = Clock::now();
+    for (long long i = 0; i < iterations; i++) {
+      f();
+    }
+    return secondsSince(start);
+  }, opts);
+}
+
+// For iterations that need untimed setup: f() times its own region and
+// returns the seconds it took
+template <typename F>
+Result runManual(const std::string& name, F&& f, const Options& opts = Options()) {
+  return measure(name, [&](long long iterations) {
+    double total = 0.0;
+    for (long long i = 0; i < iterations; i++) {
+      total += f();
+    }
+    return total;
+  }, opts);
+}
+
+inline void writeCsv(std::ostream& out, const std::vector<Result>& results) {
+  out << "name,iterations,samples,rejected,mean_s,stddev_s,min_s,max_s,"
+         "median_s,median_low_s,median_high_s,p90_s,p90_low_s,p90_high_s,"
+         "p99_s,p99_low_s,p99_high_s\n";
+  for (const Result& r : results) {
+    out << r.name << "," << r.iterations << "," << r.samples << "," << r.rejected
+        << "," << r.mean << "," << r.stddev << "," << r.min << "," << r.max
+        << "," << r.median << "," << r.medianLow << "," << r.medianHigh
+        << "," << r.p90 << "," << r.p90Low << "," << r.p90High
+        << "," << r.p99 << "," << r.p99Low << "," << r.p99High << "\n";
+  }
+}
+
+inline void writeJson(std::ostream& out, const std::vector<Result>& results) {
+  out << "[\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    out << "  {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+        << ", \"samples\": " << r.samples << ", \"rejected\": " << r.rejected
+        << ", \"mean_s\": " << r.mean << ", \"stddev_s\": " << r.stddev
+        << ", \"min_s\": " << r.min << ", \"max_s\": " << r.max
+        << ", \"median_s\": " << r.median << ", \"median_ci_s\": [" << r.medianLow
+        << ", " << r.medianHigh << "], \"p90_s\": " << r.p90
+        << ", \"p90_ci_s\": [" << r.p90Low << ", " << r.p90High
+        << "], \"p99_s\": " << r.p99 << ", \"p99_ci_s\": [" << r.p99Low
+        << ", " << r.p99High << "]}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  out << "]\n";
+}
+
+// Writes results to the files named by BENCH_CSV and BENCH_JSON, if set
+inline void writeReports(const std::vector<Result>& results) {
+  if (const char* path = std::getenv("BENCH_CSV")) {
+    std::ofstream out(path);
+    writeCsv(out, results);
+  }
+  if (const char* path = std::getenv("BENCH_JSON")) {
+    std::ofstream out(path);
+    writeJson(out, results);
+  }
+}
+
+}  // namespace bench
@@ -0,0 +1,158 @@
+#pragma once
+
+// Hardware performance counters around any timed region, read through
+// Linux perf_event_open:
+//
+//   perf::Counters counters;
+//   counters.start();
+//   ... timed region ...
+//   perf::Sample sample = counters.stop();
+//
+// Each counter is opened on its own, so a CPU or kernel that lacks one
+// (or a perf_event_paranoid setting that forbids it) only loses that one.
+// Unavailable counters read as -1, which is also what the CSV columns
+// record. Threads the region starts are counted too.
+
+#include <cstdint>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perf {
+
+enum Counter {
+  Cycles,
+  Instructions,
+  L1DMisses,
+  LLCMisses,
+  DTLBMisses,
+  BranchMisses,
+  NumCounters
+};
+
+const char* const counterNames[NumCounters] = {
+  "Cycles", "Instructions", "L1D_Misses", "LLC_Misses", "DTLB_Misses", "Branch_Misses"
+};
+
+struct Sample {
+  double values[NumCounters] = {-1, -1, -1, -1, -1, -1};
+
+  bool available(Counter c) const { return values[c] >= 0; }
+
+  double operator[](Counter c) const { return values[c]; }
+
+  // Per-iteration values when the region ran `iterations` times
+  Sample per(double iterations) const {
+    Sample s;
+    for (int c = 0; c < NumCounters; c++) {
+      s.values[c] = values[c] < 0 ? -1 : values[c] / iterations;
+    }
+    return s;
+  }
+};
+
+// CSV header cells for every counter, e.g. "Seq_Cycles,Seq_Instructions,..."
+inline std::string csvHeader(const std::string& prefix) {
+  std::string header;
+  for (int c = 0; c < NumCounters; c++) {
+    if (c > 0) header += ",";
+    header += prefix + counterNames[c];
+  }
+  return header;
+}
+
+inline std::string csvValues(const Sample& sample) {
+  std::string values;
+  for (int c = 0; c < NumCounters; c++) {
+    if (c > 0) values += ",";
+    values += sample.values[c] < 0 ? "-1" : std::to_string((long long)sample.values[c]);
+  }
+  return values;
+}
+
+class Counters {
+public:
+  Counters() {
+#ifdef __linux__
+    const uint64_t readMiss =
+      (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    open(Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    open(Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    open(L1DMisses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | readMiss);
+    open(LLCMisses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | readMiss);
+    open(DTLBMisses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | readMiss);
+    open(BranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+  }
+
+  ~Counters() {
+#ifdef __linux__
+    for (int fd : fds) {
+      if (fd >= 0) close(fd);
+    }
+#endif
+  }
+
+  Counters(const Counters&) = delete;
+  Counters& operator=(const Counters&) = delete;
+
+  bool anyAvailable() const {
+    for (int fd : fds) {
+      if (fd >= 0) return true;
+    }
+    return false;
+  }
+
+  void start() {
+#ifdef __linux__
+    for (int fd : fds) {
+      if (fd < 0) continue;
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  Sample stop() {
+    Sample sample;
+#ifdef __linux__
+    for (int c = 0; c < NumCounters; c++) {
+      if (fds[c] >= 0) ioctl(fds[c], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (int c = 0; c < NumCounters; c++) {
+      // value, time enabled, time running; scale up if the kernel had to
+      // multiplex the counter
+      uint64_t data[3];
+      if (fds[c] < 0 || read(fds[c], data, sizeof(data)) != sizeof(data)) continue;
+      if (data[2] == 0) continue;
+      sample.values[c] = (double)data[0] * data[1] / data[2];
+    }
+#endif
+    return sample;
+  }
+
+private:
+#ifdef __linux__
+  void open(Counter c, uint32_t type, uint64_t config) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds[c] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+#endif
+
+  int fds[NumCounters] = {-1, -1, -1, -1, -1, -1};
+};
+
+}  // namespace perf
@@ -0,0 +1,199 @@
+#pragma once
+
+// Header-only background sampler of process memory and paging:
+//
+//   resources::Sampler sampler;              // starts sampling every 10 ms
+//   sampler.begin("random/C/M=1.0");
+//   ... workload ...
+//   resources::Phase phase = sampler.end();
+//   phase.majorFaults, phase.peakRssKb, ...
+//
+// Each sample holds RSS and swap from /proc/self/status and the process's
+// minor and major fault counts from /proc/self/stat. begin() and end() take
+// a sample of their own on the calling thread, so a phase's deltas cover
+// exactly that phase and nothing before it, and its peaks come from every
+// sample in between. The series, with the phase each sample falls in, is
+// appended to a CSV stream a batch at a time.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace resources {
+
+struct Sample {
+  double seconds = 0;  // since the sampler started
+  long rssKb = -1;     // -1 where /proc is unavailable
+  long swapKb = -1;
+  long minorFaults = -1;
+  long majorFaults = -1;
+  int phase = -1;      // index into Sampler::phases(), -1 outside any phase
+};
+
+struct Phase {
+  std::string name;
+  double seconds = 0;
+  long minorFaults = 0;  // during the phase
+  long majorFaults = 0;
+  long rssDeltaKb = 0;   // RSS at the end minus RSS at the start
+  long peakRssKb = 0;
+  long peakSwapKb = 0;
+};
+
+// Reads /proc/self/status and /proc/self/stat now
+inline Sample readSample() {
+  Sample s;
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmRSS:", 0) == 0) s.rssKb = std::atol(line.c_str() + 6);
+    else if (line.rfind("VmSwap:", 0) == 0) s.swapKb = std::atol(line.c_str() + 7);
+  }
+
+  // Fields after the command name, which may itself hold spaces and ')':
+  // state ppid pgrp session tty_nr tpgid flags minflt cminflt majflt
+  std::ifstream stat("/proc/self/stat");
+  std::string contents((std::istreambuf_iterator<char>(stat)), std::istreambuf_iterator<char>());
+  size_t close = contents.rfind(')');
+  if (close != std::string::npos) {
+    std::istringstream fields(contents.substr(close + 1));
+    std::string state;
+    long ppid, pgrp, session, tty, tpgid, cminflt;
+    unsigned long flags;
+    fields >> state >> ppid >> pgrp >> session >> tty >> tpgid >> flags >> s.minorFaults >> cminflt >>
+      s.majorFaults;
+    if (!fields) s.minorFaults = s.majorFaults = -1;
+  }
+  return s;
+}
+
+class Sampler {
+public:
+  explicit Sampler(std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+    : interval(interval), start(Clock::now()) {
+    worker = std::thread([this]() { run(); });
+  }
+
+  ~Sampler() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+  }
+
+  Sampler(const Sampler&) = delete;
+  Sampler& operator=(const Sampler&) = delete;
+
+  // Opens a phase; one phase is open at a time
+  void begin(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Phase phase;
+    phase.name = name;
+    allPhases.push_back(phase);
+    current = allPhases.size() - 1;
+    generation++;
+    phaseFirst = stamp(readSample(), current);
+    record(phaseFirst);
+  }
+
+  // Closes the open phase and returns its deltas and peaks
+  Phase end() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (current < 0) return Phase();
+    Sample last = stamp(readSample(), current);
+    record(last);
+
+    Phase& phase = allPhases[current];
+    phase.seconds = last.seconds - phaseFirst.seconds;
+    phase.minorFaults = last.minorFaults - phaseFirst.minorFaults;
+    phase.majorFaults = last.majorFaults - phaseFirst.majorFaults;
+    phase.rssDeltaKb = last.rssKb - phaseFirst.rssKb;
+    current = -1;
+    generation++;
+    return phase;
+  }
+
+  std::vector<Phase> phases() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return allPhases;
+  }
+
+  // Appends the samples taken since the last call to out, with the header
+  // on the first call, and forgets them, so a long run holds only what it
+  // has not written yet
+  void writeCsv(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!headerWritten) {
+      out << "seconds,rss_kb,swap_kb,minor_faults,major_faults,phase\n";
+      headerWritten = true;
+    }
+    for (const Sample& s : pending) {
+      out << s.seconds << "," << s.rssKb << "," << s.swapKb << "," << s.minorFaults << ","
+          << s.majorFaults << "," << (s.phase >= 0 ? allPhases[s.phase].name : "") << "\n";
+    }
+    out.flush();
+    pending.clear();
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+      // Read without the lock, so begin() and end() never wait on /proc. A
+      // phase that opened or closed meanwhile has its own sample, newer
+      // than this one, so this one is dropped rather than misfiled.
+      long seen = generation;
+      int phase = current;
+      lock.unlock();
+      Sample s = stamp(readSample(), phase);
+      lock.lock();
+      if (generation == seen) record(s);
+      wake.wait_for(lock, interval, [this]() { return stopping; });
+    }
+  }
+
+  // Times s as of now and tags it with phase
+  Sample stamp(Sample s, int phase) const {
+    s.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    s.phase = phase;
+    return s;
+  }
+
+  // Caller holds the lock
+  void record(const Sample& s) {
+    if (s.phase >= 0) {
+      Phase& phase = allPhases[s.phase];
+      phase.peakRssKb = std::max(phase.peakRssKb, s.rssKb);
+      phase.peakSwapKb = std::max(phase.peakSwapKb, s.swapKb);
+    }
+    pending.push_back(s);
+  }
+
+  std::chrono::milliseconds interval;
+  Clock::time_point start;
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  std::vector<Sample> pending;
+  bool headerWritten = false;
+  std::vector<Phase> allPhases;
+  int current = -1;
+  long generation = 0;  // bumped by every begin() and end()
+  Sample phaseFirst;
+  std::thread worker;
+};
+
+}  // namespace resources
@@ -0,0 +1,186 @@
+#pragma once
+
+// Header-only random numbers for benchmark inputs, fast enough that
+// generating a workload does not cost more than running it.
+//
+//   rng::Generator gen(rng::randomSeed(), threadIndex);
+//   gen.fillUniform(values.data(), values.size(), 1, 100);
+//
+// Each Generator runs `lanes` xoshiro256++ states side by side, laid out so
+// the compiler turns a refill into SIMD. Lane l of stream s starts s long
+// jumps (2^192 steps) plus l jumps (2^128 steps) past the seeded state, so
+// every stream and lane is disjoint from every other. Bounded values use
+// Lemire's multiply-shift reduction, which is unbiased and almost never
+// needs a division.
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <type_traits>
+
+namespace rng {
+
+inline uint64_t splitmix64(uint64_t& state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+// A seed from the operating system, for runs that should differ
+inline uint64_t randomSeed() {
+  std::random_device rd;
+  return uint64_t(rd()) << 32 | rd();
+}
+
+inline uint64_t rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+class Generator {
+public:
+  static constexpr int lanes = 8;
+  static constexpr int bufferWords = 512;  // 32-bit outputs per refill
+
+  explicit Generator(uint64_t seed, uint64_t stream = 0) {
+    uint64_t state[4];
+    for (uint64_t& word : state) word = splitmix64(seed);
+    for (uint64_t s = 0; s < stream; s++) jump(state, longJumpPolynomial);
+    for (int l = 0; l < lanes; l++) {
+      for (int w = 0; w < 4; w++) lane[w][l] = state[w];
+      jump(state, jumpPolynomial);
+    }
+  }
+
+  uint32_t next32() {
+    if (used == bufferWords) refill();
+    return buffer[used++];
+  }
+
+  uint64_t next64() {
+    uint64_t high = next32();
+    return high << 32 | next32();
+  }
+
+  // Uniform in [0, range), range > 0
+  uint32_t uniform(uint32_t range) {
+    uint64_t product = uint64_t(next32()) * range;
+    uint32_t low = uint32_t(product);
+    if (low < range) {
+      uint32_t threshold = -range % range;
+      while (low < threshold) {
+        product = uint64_t(next32()) * range;
+        low = uint32_t(product);
+      }
+    }
+    return product >> 32;
+  }
+
+  // Fills out[0, count) uniformly from [low, high], inclusive like
+  // std::uniform_int_distribution; high - low must fit in 32 bits. The
+  // reduction runs over whole buffers at once and redraws the rare
+  // rejected values afterwards.
+  template <typename T>
+  void fillUniform(T* out, size_t count, T low, T high) {
+    static_assert(std::is_integral_v<T>);
+    uint64_t range = uint64_t(high) - uint64_t(low) + 1;
+    if (range == uint64_t(1) << 32) {
+      for (size_t i = 0; i < count; i++) out[i] = T(uint64_t(low) + next32());
+      return;
+    }
+    uint32_t r = uint32_t(range);
+    uint32_t threshold = -r % r;
+
+    for (size_t i = 0; i < count;) {
+      if (used == bufferWords) refill();
+      size_t k = std::min<size_t>(count - i, bufferWords - used);
+      const uint32_t* words = buffer + used;
+      bool rejected = false;
+      for (size_t j = 0; j < k; j++) {
+        uint64_t product = uint64_t(words[j]) * r;
+        out[i + j] = T(uint64_t(low) + (product >> 32));
+        rejected |= uint32_t(product) < threshold;
+      }
+      if (rejected) {
+        // Find them all before redrawing, which may refill the buffer
+        uint32_t redo[bufferWords];
+        size_t redoCount = 0;
+        for (size_t j = 0; j < k; j++) {
+          if (uint32_t(uint64_t(words[j]) * r) < threshold) redo[redoCount++] = j;
+        }
+        used += k;
+        for (size_t j = 0; j < redoCount; j++) {
+          out[i + redo[j]] = T(uint64_t(low) + uniform(r));
+        }
+      } else {
+        used += k;
+      }
+      i += k;
+    }
+  }
+
+  // Fills out[0, count) uniformly from [0, 1) in steps of 2^-32
+  void fillUnit(double* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      out[i] = next32() * 0x1p-32;
+    }
+  }
+
+private:
+  static constexpr uint64_t jumpPolynomial[4] = {
+    0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c
+  };
+  static constexpr uint64_t longJumpPolynomial[4] = {
+    0x76e15d3efefdcbbf, 0xc5004e441c522fb3, 0x77710069854ee241, 0x39109bb02acbe635
+  };
+
+  static void step(uint64_t s[4]) {
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+  }
+
+  static void jump(uint64_t s[4], const uint64_t polynomial[4]) {
+    uint64_t result[4] = {0, 0, 0, 0};
+    for (int w = 0; w < 4; w++) {
+      for (int b = 0; b < 64; b++) {
+        if (polynomial[w] >> b & 1) {
+          for (int i = 0; i < 4; i++) result[i] ^= s[i];
+        }
+        step(s);
+      }
+    }
+    for (int i = 0; i < 4; i++) s[i] = result[i];
+  }
+
+  // Every lane advances once per round; the lane loop has no dependencies
+  // between iterations, so it vectorizes
+  void refill() {
+    for (int round = 0; round < bufferWords / (2 * lanes); round++) {
+      uint32_t* out = buffer + round * 2 * lanes;
+      for (int l = 0; l < lanes; l++) {
+        uint64_t result = rotl(lane[0][l] + lane[3][l], 23) + lane[0][l];
+        uint64_t t = lane[1][l] << 17;
+        lane[2][l] ^= lane[0][l];
+        lane[3][l] ^= lane[1][l];
+        lane[1][l] ^= lane[2][l];
+        lane[0][l] ^= lane[3][l];
+        lane[2][l] ^= t;
+        lane[3][l] = rotl(lane[3][l], 45);
+        out[l] = uint32_t(result);
+        out[lanes + l] = uint32_t(result >> 32);
+      }
+    }
+    used = 0;
+  }
+
+  alignas(64) uint64_t lane[4][lanes];
+  alignas(64) uint32_t buffer[bufferWords];
+  int used = bufferWords;
+};
+
+}  // namespace rng